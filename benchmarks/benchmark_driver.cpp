@@ -0,0 +1,386 @@
+#include <jlcxx/jlcxx.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Driver for the Julia <-> C++ boundary microbenchmarks. The module from benchmark_module.cpp is registered into a
+// Julia module created here, and each benchmark is a Julia function taking an iteration count n and performing n
+// operations. The results are written as JSON:
+//
+// {
+//   "schema_version": 1, "jlcxx_version": "...", "julia_version": "...", "min_time_ms": 100.0, "repetitions": 5,
+//   "cxxwrap_init_ms": 250.0,
+//   "benchmarks": [
+//     {"group": "call", "name": "function_pointer", "status": "ok", "iterations": 1048576, "items_per_op": 1,
+//      "min_ns_per_op": 2.5, "median_ns_per_op": 2.6, "mean_ns_per_op": 2.6, "max_ns_per_op": 2.9},
+//     {"group": "...", "name": "...", "status": "error", "error": "..."}
+//   ]
+// }
+//
+// Benchmarks appear in a fixed order and are identified by group and name. Fields are only ever added, and
+// schema_version is incremented when an existing field changes meaning. cxxwrap_init_ms is the time taken to load
+// CxxWrap, including the StdLib module, so comparing runs with and without JLCXX_LAZY_STL=1 shows the cost
+// of wrapping all STL container combinations up front.
+//
+// Usage: jlcxx_benchmarks [--output file.json] [--filter substring] [--min-time-ms 100] [--repetitions 5]
+
+JLCXX_MODULE define_benchmark_module(jlcxx::Module& mod);
+
+namespace jlcxx_benchmarks
+{
+
+constexpr int json_schema_version = 1;
+
+struct Benchmark
+{
+  /// Group and name identify the benchmark in the output and must not change between versions
+  const char* group;
+  const char* name;
+  /// Number of elements processed by one operation, for the array and container benchmarks
+  std::int64_t items_per_op;
+  /// Julia expression, evaluated in the benchmark module, returning a function of the iteration count
+  const char* source;
+};
+
+const std::vector<Benchmark>& benchmarks()
+{
+  static const std::vector<Benchmark> result =
+  {
+    // Call overhead, for arguments and return type that need no conversion
+    {"call", "julia_noinline", 1, "n -> (s = 0.0; for _ in 1:n; s = noinline_add(s, 1.0); end; s)"},
+    {"call", "function_pointer", 1, "n -> (s = 0.0; for _ in 1:n; s = add_fptr(s, 1.0); end; s)"},
+    {"call", "static_trampoline", 1, "n -> (s = 0.0; for _ in 1:n; s = add_static(s, 1.0); end; s)"},
+    {"call", "stateless_lambda", 1, "n -> (s = 0.0; for _ in 1:n; s = add_lambda(s, 1.0); end; s)"},
+    {"call", "std_function", 1, "n -> (s = 0.0; for _ in 1:n; s = add_std_function(s, 1.0); end; s)"},
+
+    // Boxing and unboxing, per mapping trait
+    {"boxing", "fundamental_int", 1, "n -> (s = 0; for i in 1:n; s += roundtrip_int(i); end; s)"},
+    {"boxing", "fundamental_bool", 1, "n -> (b = false; for _ in 1:n; b = roundtrip_bool(b); end; b)"},
+    {"boxing", "enum", 1, "n -> (c = red; for _ in 1:n; c = roundtrip_enum(c); end; c)"},
+    {"boxing", "mirrored_bits", 1, "n -> (p = Point(1.0, 2.0); for _ in 1:n; p = roundtrip_point(p); end; p)"},
+    {"boxing", "string", 1, "let s = \"jlcxx benchmark\"; n -> (l = 0; for _ in 1:n; l += ncodeunits(roundtrip_string(s)); end; l) end"},
+    {"boxing", "jl_value", 1, "let v = Any[1.0]; n -> (for _ in 1:n; v[1] = roundtrip_any(v[1]); end; v[1]) end"},
+    {"boxing", "unbox_wrapped_ref", 1, "let p = Particle(1.0, 2.0); n -> (s = 0.0; for _ in 1:n; s += unbox_particle_ref(p); end; s) end"},
+    {"boxing", "unbox_wrapped_ptr", 1, "let p = Particle(1.0, 2.0); n -> (s = 0.0; for _ in 1:n; s += unbox_particle_ptr(CxxPtr(p)); end; s) end"},
+    {"boxing", "box_wrapped_ref", 1, "let p = Particle(1.0, 2.0); n -> (r = box_particle_ref(p); for _ in 2:n; r = box_particle_ref(p); end; r) end"},
+
+    // ArrayRef iteration on the C++ side, 1000 elements per call
+    {"arrayref", "sum_double", 1000, "let a = collect(1.0:1000.0); n -> (s = 0.0; for _ in 1:n; s += arrayref_sum(a); end; s) end"},
+    {"arrayref", "scale_double", 1000, "let a = ones(1000); n -> (for _ in 1:n; arrayref_scale!(a, 1.0); end; a) end"},
+    {"arrayref", "sum_wrapped", 1000, "let ps = [Particle(Float64(i), 0.0) for i in 1:1000], a = CxxRef{Particle}[CxxRef(p) for p in ps]; n -> (s = 0.0; GC.@preserve ps for _ in 1:n; s += arrayref_sum_particles(a); end; s) end"},
+
+    // STL containers
+    {"stl", "vector_push", 1, "let v = StdVector{Float64}(); n -> (resize!(v, 0); for i in 1:n; push!(v, Float64(i)); end; length(v)) end"},
+    {"stl", "vector_getindex", 1, "let v = StdVector(collect(1.0:1000.0)); n -> (s = 0.0; for i in 1:n; s += v[mod1(i, 1000)]; end; s) end"},
+    {"stl", "vector_append", 1000, "let v = StdVector{Float64}(), a = collect(1.0:1000.0); n -> (for _ in 1:n; resize!(v, 0); append!(v, a); end; length(v)) end"},
+    {"stl", "vector_getrange", 1000, "let v = StdVector(collect(1.0:1000.0)), a = zeros(1000); n -> (for _ in 1:n; CxxWrap.StdLib.cxxgetrange!(v, a, 1); end; sum(a)) end"},
+    {"stl", "set_iterate", 1000, "let v = StdSet{Float64}(); for i in 1:1000; push!(v, Float64(i)); end; n -> (s = 0.0; for _ in 1:n; for x in v; s += x; end; end; s) end"},
+    {"stl", "set_iterate_chunked", 1000, "let v = StdSet{Float64}(), buf = zeros(256); for i in 1:1000; push!(v, Float64(i)); end; n -> (s = 0.0; for _ in 1:n; c = Ref(CxxWrap.StdLib.chunk_cursor(v)); while true; k = CxxWrap.StdLib.chunk_next!(v, buf, c); for i in 1:k; s += buf[i]; end; k < length(buf) && break; end; end; s) end"},
+    {"stl", "set_in_bulk", 1000, "let v = StdSet{Float64}(), keys = collect(1.0:1000.0), dest = Vector{Bool}(undef, 1000); for i in 1:2:1000; push!(v, Float64(i)); end; n -> (for _ in 1:n; CxxWrap.StdLib.set_in!(dest, v, keys); end; count(dest)) end"},
+    {"stl", "pq_push_pop", 1000, "let q = StdPriorityQueue{Float64}(); n -> (s = 0.0; for _ in 1:n; for i in 1:100; push!(q, Float64(i)); end; while !isempty(q); s += first(q); pop!(q); end; end; s) end"},
+    {"stl", "pq_push_pop_bulk", 1000, "let q = StdPriorityQueue{Float64}(), a = collect(1.0:100.0), dest = zeros(100); n -> (s = 0.0; for _ in 1:n; CxxWrap.StdLib.pq_push_all!(q, a); CxxWrap.StdLib.pq_pop_n!(dest, q); s += sum(dest); end; s) end"},
+    {"stl", "vector_sort_parallel", 1, "let a = rand(1_000_000), v = StdVector{Float64}(); n -> (for _ in 1:n; resize!(v, 0); append!(v, a); CxxWrap.StdLib.StdSort(v); end; v[1]) end"},
+    {"stl", "vector_reduce_parallel", 100, "let v = StdVector(rand(1_000_000)); n -> (s = 0.0; for _ in 1:n; s += CxxWrap.StdLib.StdReduce(v); end; s) end"},
+    {"stl", "valarray_axpy", 1000, "let v = StdValArray(ones(1000)), w = StdValArray(ones(1000)); n -> (for _ in 1:n; CxxWrap.StdLib.valarray_mul!(v, 0.5); CxxWrap.StdLib.valarray_add!(v, w); end; CxxWrap.StdLib.valarray_sum(v)) end"},
+    {"stl", "unordered_map_get_all", 1000, "let m = StdUnorderedMap{Int64,Float64}(), keys = collect(Int64, 1:1000), vals = zeros(1000), found = Vector{Bool}(undef, 1000); CxxWrap.StdLib.map_insert_all!(m, keys, Float64.(keys)); n -> (for _ in 1:n; CxxWrap.StdLib.map_get_all!(vals, found, m, keys); end; sum(vals)) end"},
+    {"stl", "vector_sum_cpp", 1000, "let v = StdVector(collect(1.0:1000.0)); n -> (s = 0.0; for _ in 1:n; s += vector_sum(v); end; s) end"},
+    {"stl", "vector_fill_cpp", 1000, "let v = StdVector{Float64}(); n -> (for _ in 1:n; vector_fill!(v, 1000); end; length(v)) end"},
+    {"stl", "vector_return_wrapped", 1000, "n -> (s = 0.0; for _ in 1:n; s += vector_return(1000)[1000]; end; s)"},
+    {"stl", "vector_return_array", 1000, "n -> (s = 0.0; for _ in 1:n; s += vector_return_array(1000)[1000]; end; s)"},
+    {"stl", "wrapped_vector_sum_cpp", 1000, "let v = StdVector{Particle}(); for i in 1:1000; push!(v, Particle(Float64(i), 0.0)); end; n -> (s = 0.0; for _ in 1:n; s += particle_vector_sum(v); end; s) end"},
+
+    // Callbacks from C++ into Julia, the loop runs in C++
+    {"callback", "julia_function", 1, "let f = x -> x / 2; n -> call_julia_function(f, n) end"},
+    {"callback", "cfunction", 1, "let f = @safe_cfunction(half, Float64, (Float64,)); n -> call_cfunction(f, n) end"},
+
+    // Creation of wrapped objects, with and without running the finalizer immediately
+    {"lifetime", "box_wrapped_value", 1, "let p = Particle(1.0, 2.0); n -> (for _ in 1:n; q = box_particle_value(p); finalize(q); end; p) end"},
+    {"lifetime", "construct", 1, "n -> (s = 0.0; for i in 1:n; s += particle_x(Particle(Float64(i), 0.0)); end; s)"},
+    {"lifetime", "construct_finalize", 1, "n -> (for i in 1:n; p = Particle(Float64(i), 0.0); finalize(p); end)"},
+    {"lifetime", "construct_gc", 1, "n -> (for _ in 1:n; Particle(); end; GC.gc())"},
+    {"lifetime", "construct_gc_direct_finalizer", 1, "n -> (for _ in 1:n; DirectParticle(); end; GC.gc())"},
+    {"lifetime", "construct_finalize_pooled", 1, "n -> (for _ in 1:n; p = PooledParticle(); finalize(p); end)"},
+    {"lifetime", "construct_gc_inline", 1, "n -> (for _ in 1:n; InlineParticle(); end; GC.gc())"},
+    {"lifetime", "box_inline_value", 1, "let p = InlineParticle(); n -> (q = p; for _ in 1:n; q = box_inline_value(q); end; q) end"},
+  };
+  return result;
+}
+
+struct Options
+{
+  std::string output_path;
+  std::string filter;
+  double min_time_ms = 100.0;
+  int repetitions = 5;
+};
+
+struct Result
+{
+  const Benchmark* benchmark = nullptr;
+  std::string error;
+  std::int64_t iterations = 0;
+  std::vector<double> ns_per_op;
+};
+
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+  for(int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if(i + 1 == argc)
+    {
+      throw std::runtime_error("Missing value for argument " + arg);
+    }
+    const std::string value = argv[++i];
+    if(arg == "--output")
+    {
+      options.output_path = value;
+    }
+    else if(arg == "--filter")
+    {
+      options.filter = value;
+    }
+    else if(arg == "--min-time-ms")
+    {
+      options.min_time_ms = std::stod(value);
+    }
+    else if(arg == "--repetitions")
+    {
+      options.repetitions = std::max(1, std::stoi(value));
+    }
+    else
+    {
+      throw std::runtime_error("Unknown argument " + arg);
+    }
+  }
+  return options;
+}
+
+/// Message of the pending Julia exception, which is cleared
+std::string exception_message()
+{
+  jl_value_t* exc = jl_exception_occurred();
+  JL_GC_PUSH1(&exc);
+  jl_exception_clear();
+  jl_value_t* msg = jl_call2(jl_get_function(jl_base_module, "sprint"), jl_get_function(jl_base_module, "showerror"), exc);
+  std::string result = msg != nullptr && jl_is_string(msg) ? jl_string_ptr(msg) : "unknown Julia error";
+  jl_exception_clear();
+  JL_GC_POP();
+  return result;
+}
+
+/// Time one call of f(n), in nanoseconds, or a negative number if the call threw
+double time_call(jl_value_t* f, const std::int64_t n)
+{
+  const auto start = std::chrono::steady_clock::now();
+  jl_call1(f, jl_box_int64(n));
+  const auto end = std::chrono::steady_clock::now();
+  if(jl_exception_occurred())
+  {
+    return -1.0;
+  }
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+Result run_benchmark(jl_module_t* mod, const Benchmark& benchmark, const Options& options)
+{
+  Result result;
+  result.benchmark = &benchmark;
+  jl_value_t* f = jl_cstr_to_string(benchmark.source);
+  JL_GC_PUSH1(&f);
+  f = jl_call2(jl_get_function(jl_base_module, "include_string"), (jl_value_t*)mod, f);
+  if(jl_exception_occurred())
+  {
+    result.error = exception_message();
+    JL_GC_POP();
+    return result;
+  }
+
+  // Compile, then double the iteration count until a single run takes at least the minimum time
+  const double min_time_ns = options.min_time_ms * 1e6;
+  std::int64_t n = 1;
+  double elapsed = time_call(f, n);
+  while(elapsed >= 0.0 && elapsed < min_time_ns && n < (std::int64_t(1) << 40))
+  {
+    n *= 2;
+    elapsed = time_call(f, n);
+  }
+
+  for(int i = 0; i != options.repetitions && elapsed >= 0.0; ++i)
+  {
+    jl_gc_collect(JL_GC_FULL);
+    elapsed = time_call(f, n);
+    result.ns_per_op.push_back(elapsed / double(n));
+  }
+  if(elapsed < 0.0)
+  {
+    result.error = exception_message();
+    result.ns_per_op.clear();
+  }
+  result.iterations = n;
+
+  JL_GC_POP();
+  return result;
+}
+
+std::string json_escape(const std::string& s)
+{
+  std::stringstream result;
+  for(const char c : s)
+  {
+    switch(c)
+    {
+    case '"':
+      result << "\\\"";
+      break;
+    case '\\':
+      result << "\\\\";
+      break;
+    case '\n':
+      result << "\\n";
+      break;
+    case '\t':
+      result << "\\t";
+      break;
+    default:
+      if(static_cast<unsigned char>(c) < 0x20)
+      {
+        result << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+      }
+      else
+      {
+        result << c;
+      }
+    }
+  }
+  return result.str();
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results, const Options& options, const double init_ms)
+{
+  out << std::fixed << std::setprecision(3);
+  out << "{\n";
+  out << "  \"schema_version\": " << json_schema_version << ",\n";
+  out << "  \"jlcxx_version\": \"" << JLCXX_VERSION_STRING << "\",\n";
+  out << "  \"julia_version\": \"" << json_escape(jl_ver_string()) << "\",\n";
+  out << "  \"min_time_ms\": " << options.min_time_ms << ",\n";
+  out << "  \"repetitions\": " << options.repetitions << ",\n";
+  out << "  \"cxxwrap_init_ms\": " << init_ms << ",\n";
+  out << "  \"benchmarks\": [";
+  for(std::size_t i = 0; i != results.size(); ++i)
+  {
+    const Result& result = results[i];
+    out << (i == 0 ? "\n" : ",\n");
+    out << "    {\"group\": \"" << result.benchmark->group << "\", \"name\": \"" << result.benchmark->name << "\", ";
+    if(!result.error.empty())
+    {
+      out << "\"status\": \"error\", \"error\": \"" << json_escape(result.error) << "\"}";
+      continue;
+    }
+    std::vector<double> sorted = result.ns_per_op;
+    std::sort(sorted.begin(), sorted.end());
+    const double median = sorted.size() % 2 == 1 ? sorted[sorted.size() / 2] : 0.5 * (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]);
+    const double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / double(sorted.size());
+    out << "\"status\": \"ok\", \"iterations\": " << result.iterations
+        << ", \"items_per_op\": " << result.benchmark->items_per_op
+        << ", \"min_ns_per_op\": " << sorted.front()
+        << ", \"median_ns_per_op\": " << median
+        << ", \"mean_ns_per_op\": " << mean
+        << ", \"max_ns_per_op\": " << sorted.back() << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  using namespace jlcxx_benchmarks;
+
+  Options options;
+  try
+  {
+    options = parse_options(argc, argv);
+  }
+  catch(const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "Usage: " << argv[0] << " [--output file.json] [--filter substring] [--min-time-ms 100] [--repetitions 5]" << std::endl;
+    return 2;
+  }
+
+  const auto init_start = std::chrono::steady_clock::now();
+  jlcxx::cxxwrap_init();
+  const double init_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - init_start).count();
+
+  jl_value_t* mod = jl_eval_string(R"(
+    module JlCxxBenchmarks
+      const __cxxwrap_pointers = Ptr{Cvoid}[]
+      using CxxWrap
+      struct Point
+        x::Float64
+        y::Float64
+      end
+      @noinline noinline_add(a::Float64, b::Float64) = a + b
+      half(x::Float64) = x / 2
+    end
+  )");
+  JL_GC_PUSH1(&mod);
+
+  register_julia_module((jl_module_t*)mod, define_benchmark_module);
+  jl_call1(jl_get_function(jlcxx::get_cxxwrap_module(), "wraptypes"), mod);
+  jl_call1(jl_get_function(jlcxx::get_cxxwrap_module(), "wrapfunctions"), mod);
+  if(jl_exception_occurred())
+  {
+    jl_call2(jl_get_function(jl_base_module, "showerror"), jl_stderr_obj(), jl_exception_occurred());
+    jl_printf(jl_stderr_stream(), "\n");
+    return 1;
+  }
+
+  std::vector<Result> results;
+  int nb_errors = 0;
+  for(const Benchmark& benchmark : benchmarks())
+  {
+    const std::string full_name = std::string(benchmark.group) + "/" + benchmark.name;
+    if(!options.filter.empty() && full_name.find(options.filter) == std::string::npos)
+    {
+      continue;
+    }
+    results.push_back(run_benchmark((jl_module_t*)mod, benchmark, options));
+    if(!results.back().error.empty())
+    {
+      ++nb_errors;
+      std::cerr << full_name << ": " << results.back().error << std::endl;
+    }
+  }
+
+  JL_GC_POP();
+
+  if(options.output_path.empty())
+  {
+    write_json(std::cout, results, options, init_ms);
+  }
+  else
+  {
+    std::ofstream out(options.output_path);
+    write_json(out, results, options, init_ms);
+    if(!out)
+    {
+      std::cerr << "Error writing " << options.output_path << std::endl;
+      return 1;
+    }
+  }
+
+  jl_atexit_hook(0);
+  return nb_errors == 0 ? 0 : 1;
+}
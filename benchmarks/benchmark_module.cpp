@@ -0,0 +1,185 @@
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "jlcxx/jlcxx.hpp"
+#include "jlcxx/functions.hpp"
+#include "jlcxx/stl.hpp"
+
+// Functions and types exercised by the benchmark driver. Each function is kept trivial, so the measured time is
+// dominated by the call, the argument conversion and the boxing of the result.
+
+namespace jlcxx_benchmarks
+{
+
+/// Wrapped type (CxxWrappedTrait), allocated on the heap when returned by value
+struct Particle
+{
+  Particle() = default;
+  Particle(double x, double y) : x(x), y(y)
+  {
+  }
+
+  double x = 0.0;
+  double y = 0.0;
+};
+
+/// Same as Particle, but finalized directly from the GC
+struct DirectParticle
+{
+  double x = 0.0;
+};
+
+/// Same as Particle, but allocated from a PoolAllocator
+struct PooledParticle
+{
+  double x = 0.0;
+};
+
+/// Same as Particle, but stored inside the Julia object
+struct InlineParticle
+{
+  InlineParticle(double x = 0.0) : x(x)
+  {
+  }
+
+  double x;
+};
+
+/// Bits type with an identical Julia struct (mirrored, using map_type)
+struct Point
+{
+  double x;
+  double y;
+};
+
+enum class Color
+{
+  red,
+  green,
+  blue
+};
+
+double add(double a, double b)
+{
+  return a + b;
+}
+
+std::string echo_string(const std::string& s)
+{
+  return s;
+}
+
+}
+
+namespace jlcxx
+{
+  template<> struct DirectFinalizer<jlcxx_benchmarks::DirectParticle> : std::true_type { };
+  template<> struct Allocator<jlcxx_benchmarks::PooledParticle> : PoolAllocator<jlcxx_benchmarks::PooledParticle> { };
+  template<> struct InlineStorage<jlcxx_benchmarks::InlineParticle> : std::true_type { };
+}
+
+JLCXX_MODULE define_benchmark_module(jlcxx::Module& mod)
+{
+  using namespace jlcxx_benchmarks;
+
+  mod.map_type<Point>("Point");
+  mod.add_bits<Color>("Color", jlcxx::julia_type("CppEnum"));
+  mod.set_const("red", Color::red);
+  mod.set_const("blue", Color::blue);
+
+  mod.add_type<Particle>("Particle")
+    .constructor<double, double>()
+    .method("particle_x", [] (const Particle& p) { return p.x; });
+  mod.add_type<DirectParticle>("DirectParticle");
+  mod.add_type<PooledParticle>("PooledParticle");
+  mod.add_type<InlineParticle>("InlineParticle");
+  mod.method("box_inline_value", [] (const InlineParticle& p) { return p; });
+
+  // Call overhead: naked function pointer, static trampoline, stateless and capturing lambda
+  mod.method("add_fptr", add);
+  mod.method<add>("add_static");
+  mod.method("add_lambda", [] (double a, double b) { return a + b; });
+  const double offset = 0.0;
+  mod.method("add_std_function", [offset] (double a, double b) { return a + b + offset; });
+
+  // Boxing and unboxing for each mapping trait
+  mod.method("roundtrip_int", [] (int64_t i) { return i; });
+  mod.method("roundtrip_bool", [] (bool b) { return !b; });
+  mod.method("roundtrip_enum", [] (Color c) { return c == Color::red ? Color::blue : Color::red; });
+  mod.method("roundtrip_point", [] (const Point& p) { return Point({p.y, p.x}); });
+  mod.method("roundtrip_string", echo_string);
+  mod.method("roundtrip_any", [] (jl_value_t* v) { return v; });
+  mod.method("unbox_particle_ref", [] (const Particle& p) { return p.x; });
+  mod.method("unbox_particle_ptr", [] (const Particle* p) { return p->y; });
+  mod.method("box_particle_ref", [] (Particle& p) -> Particle& { return p; });
+  mod.method("box_particle_value", [] (const Particle& p) { return p; });
+
+  // ArrayRef iteration
+  mod.method("arrayref_sum", [] (jlcxx::ArrayRef<double> a)
+  {
+    return std::accumulate(a.begin(), a.end(), 0.0);
+  });
+  mod.method("arrayref_sum_particles", [] (jlcxx::ArrayRef<Particle> a)
+  {
+    double result = 0.0;
+    for(std::size_t i = 0; i != a.size(); ++i)
+    {
+      result += a[i].x;
+    }
+    return result;
+  });
+  mod.method("arrayref_scale!", [] (jlcxx::ArrayRef<double> a, double factor)
+  {
+    for(double& d : a)
+    {
+      d *= factor;
+    }
+  });
+
+  // STL containers
+  mod.method("vector_sum", [] (const std::vector<double>& v)
+  {
+    return std::accumulate(v.begin(), v.end(), 0.0);
+  });
+  mod.method("vector_fill!", [] (std::vector<double>& v, int64_t n)
+  {
+    v.clear();
+    for(int64_t i = 0; i != n; ++i)
+    {
+      v.push_back(double(i));
+    }
+  });
+  mod.method("vector_return", [] (int64_t n) { return std::vector<double>(n, 1.0); });
+  mod.method("vector_return_array", [] (int64_t n) { return jlcxx::to_julia_array(std::vector<double>(n, 1.0)); });
+  mod.method("particle_vector_sum", [] (const std::vector<Particle>& v)
+  {
+    double result = 0.0;
+    for(const Particle& p : v)
+    {
+      result += p.x;
+    }
+    return result;
+  });
+
+  // Callbacks into Julia, through JuliaFunction and through a cfunction pointer
+  mod.method("call_julia_function", [] (jl_value_t* f, int64_t n)
+  {
+    jlcxx::JuliaFunction julia_f(f);
+    double result = 0.0;
+    for(int64_t i = 0; i != n; ++i)
+    {
+      result += jlcxx::unbox<double>(julia_f(double(i)));
+    }
+    return result;
+  });
+  mod.method("call_cfunction", [] (double (*f)(double), int64_t n)
+  {
+    double result = 0.0;
+    for(int64_t i = 0; i != n; ++i)
+    {
+      result += f(double(i));
+    }
+    return result;
+  });
+}
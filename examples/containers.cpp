@@ -1,4 +1,7 @@
+#include <map>
+#include <string>
 #include <tuple>
+#include <unordered_map>
 
 #include "jlcxx/array.hpp"
 #include "jlcxx/jlcxx.hpp"
@@ -76,6 +79,53 @@ std::string catstrings(jlcxx::ArrayRef<const char*> strings)
   return result;
 }
 
+// Map tests: the first two map types are wrapped by the STL module, the last one on first use
+std::unordered_map<int64_t,double> make_index(jlcxx::ArrayRef<int64_t> keys)
+{
+  std::unordered_map<int64_t,double> result;
+  for(const int64_t k : keys)
+  {
+    result[k] = 0.5 * k;
+  }
+  return result;
+}
+
+double sum_index_values(const std::unordered_map<int64_t,double>& index)
+{
+  double result = 0.0;
+  for(const auto& [k, v] : index)
+  {
+    result += v;
+  }
+  return result;
+}
+
+std::map<std::string,int> count_words(jlcxx::ArrayRef<std::string> words)
+{
+  std::map<std::string,int> result;
+  for(const std::string& w : words)
+  {
+    ++result[w];
+  }
+  return result;
+}
+
+int word_count(const std::map<std::string,int>& counts, const std::string& word)
+{
+  auto it = counts.find(word);
+  return it == counts.end() ? 0 : it->second;
+}
+
+std::map<int32_t,int64_t> make_squares(const int32_t n)
+{
+  std::map<int32_t,int64_t> result;
+  for(int32_t i = 1; i <= n; ++i)
+  {
+    result[i] = int64_t(i) * i;
+  }
+  return result;
+}
+
 JLCXX_MODULE define_julia_module(jlcxx::Module& containers)
 {
   using namespace jlcxx;
@@ -127,6 +177,41 @@ JLCXX_MODULE define_julia_module(jlcxx::Module& containers)
     return data;
   });
 
+  containers.method("bulk_array_return", [] (int64_t n) {
+    std::vector<double> values(n);
+    for(int64_t i = 0; i != n; ++i)
+    {
+      values[i] = double(i);
+    }
+    jlcxx::Array<double> result;
+    result.reserve(n + 1);
+    result.append(values.begin(), values.end());
+    JL_GC_PUSH1(result.gc_pointer());
+    result.emplace_back_unchecked(-1.0);
+    JL_GC_POP();
+    return result;
+  });
+
+  containers.method("bulk_string_array_return", [] () {
+    const std::vector<std::string> words = {"hello", "bulk", "world"};
+    Array<std::string> result;
+    result.append(words.begin(), words.end());
+    return result;
+  });
+
+  containers.method("arrayref_append!", [] (jlcxx::ArrayRef<double> a, jlcxx::ArrayRef<double> b) {
+    a.append(b.begin(), b.end());
+  });
+
+  containers.method("vector_to_julia_array", [] (int64_t n) {
+    std::vector<double> values(n);
+    for(int64_t i = 0; i != n; ++i)
+    {
+      values[i] = double(i);
+    }
+    return jlcxx::to_julia_array(std::move(values));
+  });
+
   // Test some automatic type creation
   containers.method("tuple_int_pointer", [] () { return std::make_tuple(static_cast<int*>(nullptr), 1); });
   containers.method("uint8_arrayref", [] (jlcxx::ArrayRef<uint8_t *> a)
@@ -144,4 +229,9 @@ JLCXX_MODULE define_julia_module(jlcxx::Module& containers)
   containers.method("read_array_tuple", &read_array_tuple);
   containers.method("make_tuple_vector", &make_tuple_vector);
   containers.method("catstrings", &catstrings);
+  containers.method("make_index", &make_index);
+  containers.method("sum_index_values", &sum_index_values);
+  containers.method("count_words", &count_words);
+  containers.method("word_count", &word_count);
+  containers.method("make_squares", &make_squares);
 }
@@ -96,6 +96,12 @@ JLCXX_MODULE init_half_module(jlcxx::Module& mod)
   // register a standard C++ function
   mod.method("half_d", half_function);
 
+  // register a function known at compile time, called directly
+  mod.method<half_function>("half_direct");
+
+  // register a lambda that never throws, skipping the exception translation
+  mod.method("half_noexcept", [](const double x) noexcept { return 0.5*x; }, jlcxx::noexcept_call);
+
   // register some template instantiations
   mod.method("half_i", half_template<int>);
   mod.method("half_u", half_template<unsigned int>);
@@ -210,6 +216,12 @@ JLCXX_MODULE init_test_module(jlcxx::Module& mod)
   mod.method("concatenate_numbers_with_default_values_of_different_type", &concatenate_numbers, jlcxx::arg("i"), jlcxx::arg("d")=5);
   mod.method("concatenate_numbers_with_default_kwarg", &concatenate_numbers, jlcxx::arg("i"), jlcxx::kwarg("d")=5.2);
   mod.method("concatenate_strings", &concatenate_strings);
+  mod.method<concatenate_strings>("concatenate_strings_direct");
+  // the Julia GC may run on other threads while this executes
+  mod.method("concatenate_strings_gc_safe", &concatenate_strings, jlcxx::gc_safe);
+  mod.method<concatenate_numbers>("concatenate_numbers_gc_safe", jlcxx::gc_safe);
+  // Julia objects can't be used in a GC-safe region, so this doesn't compile
+  // mod.method("test_array_len_gc_safe", test_array_len, jlcxx::gc_safe);
   mod.method("test_int32_array", test_int32_array);
   mod.method("test_int64_array", test_int64_array);
   mod.method("test_float_array", test_float_array);
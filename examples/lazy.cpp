@@ -0,0 +1,35 @@
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "jlcxx/jlcxx.hpp"
+#include "jlcxx/stl.hpp"
+
+namespace lazy
+{
+
+struct Counter
+{
+  int value = 0;
+};
+
+}
+
+JLCXX_MODULE define_julia_module(jlcxx::Module& mod)
+{
+  using namespace lazy;
+
+  // The types used by the functions below are only created when the Julia side fetches the functions for their name
+  mod.set_lazy_registration(true);
+
+  mod.add_type<Counter>("Counter")
+    .method("increment!", [] (Counter& c) { return ++c.value; })
+    .method("value", [] (const Counter& c) { return c.value; });
+
+  // Overloads share a name, which is listed once by get_module_function_names
+  mod.method("lazy_sum", [] (const std::vector<double>& v) { return std::accumulate(v.begin(), v.end(), 0.0); });
+  mod.method("lazy_sum", [] (const std::vector<int>& v) { return std::accumulate(v.begin(), v.end(), 0); });
+  mod.method("lazy_tuple", [] () { return std::make_tuple(1, 2.0, std::string("three")); });
+  mod.method("lazy_strings", [] (const std::string& s, const int n) { return std::vector<std::string>(n, s); });
+}
@@ -187,6 +187,35 @@ class UseCustomClassDelete
 
 int UseCustomClassDelete::nb_deleted = 0;
 
+// Finalized straight from the GC, still going through the specialized Finalizer
+class UseDirectFinalizer
+{
+  public:
+    UseDirectFinalizer() {}
+    void getImpl() const {}
+    static int nb_deleted;
+};
+
+int UseDirectFinalizer::nb_deleted = 0;
+
+// Not mirrored because of the user-provided constructor, stored inside the Julia object
+class InlineValue
+{
+  public:
+    InlineValue(int v = 0) : m_value(v) {}
+    int value() const { return m_value; }
+    void set_value(int v) { m_value = v; }
+  private:
+    int m_value;
+};
+
+// Allocated from a thread-local pool when created from Julia or returned by value
+struct UsePoolAllocator
+{
+  UsePoolAllocator(int v = 0) : value(v) {}
+  int value;
+};
+
 void int_vec_arg(std::vector<std::shared_ptr<int>>){}
 void const_int_vec_arg(std::vector<std::shared_ptr<const int>>){}
 
@@ -198,6 +227,9 @@ namespace jlcxx
   template<> struct IsMirroredType<cpp_types::DoubleData> : std::false_type { };
   template<> struct IsMirroredType<cpp_types::NeverEmpty> : std::false_type { };
   template<typename T> struct IsSmartPointerType<cpp_types::MySmartPointer<T>> : std::true_type { };
+  template<> struct DirectFinalizer<cpp_types::UseDirectFinalizer> : std::true_type { };
+  template<> struct Allocator<cpp_types::UsePoolAllocator> : PoolAllocator<cpp_types::UsePoolAllocator> { };
+  template<> struct InlineStorage<cpp_types::InlineValue> : std::true_type { };
   template<typename T> struct ConstructorPointerType<cpp_types::MySmartPointer<T>> { typedef std::shared_ptr<T> type; };
 }
 
@@ -223,7 +255,7 @@ namespace jlcxx
         delete to_delete;
         T::nb_deleted += 1;
       } else {
-        delete to_delete;
+        Allocator<T>::deallocate(to_delete);
       }
     }
   };
@@ -254,6 +286,8 @@ JLCXX_MODULE define_julia_module(jlcxx::Module& types)
     .constructor([] (const std::string& a, const std::string& b) { return new World(a + " " + b); })
     .method("set", &World::set)
     .method("greet_cref", &World::greet)
+    .method<&World::greet>("greet_direct")
+    .method("greet_noexcept", [] (const World& w) noexcept { return w.greet(); }, jlcxx::noexcept_call)
     .method("greet_lambda", [] (const World& w) { return w.greet(); } )
     .method("greet_byvalue", [] (World w) { return w.greet(); } );
 
@@ -470,6 +504,19 @@ JLCXX_MODULE define_julia_module(jlcxx::Module& types)
   types.method("get_custom_nb_deletes", [] () { return UseCustomDelete::nb_deleted; });
   types.add_type<UseCustomClassDelete>("UseCustomClassDelete");
   types.method("get_custom_class_nb_deletes", [] () { return UseCustomClassDelete::nb_deleted; });
+  types.add_type<UseDirectFinalizer>("UseDirectFinalizer");
+  types.method("get_direct_finalizer_nb_deletes", [] () { return UseDirectFinalizer::nb_deleted; });
+  types.add_type<UsePoolAllocator>("UsePoolAllocator")
+    .constructor<int>()
+    .method("value", [] (const UsePoolAllocator& p) { return p.value; });
+  types.method("pooled_copy", [] (const UsePoolAllocator& p) { return UsePoolAllocator(p.value + 1); });
+  types.method("pool_live_objects", [] () { return jlcxx::Allocator<UsePoolAllocator>::stats().live_objects.load(); });
+  types.add_type<InlineValue>("InlineValue")
+    .constructor<int>()
+    .method("value", &InlineValue::value)
+    .method("set_value!", &InlineValue::set_value);
+  types.method("inline_incremented", [] (const InlineValue& v) { return InlineValue(v.value() + 1); });
+  types.method("inline_ref", [] (InlineValue& v) -> InlineValue& { return v; });
 
   types.method("world_dequeue", []() { static World w; return std::deque({w}); });
   types.method("world_list", []() { static World w; return std::list({w}); });
@@ -0,0 +1,250 @@
+#ifndef JLCXX_ALLOCATORS_HPP
+#define JLCXX_ALLOCATORS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "jlcxx_config.hpp"
+
+// Allocation of the C++ objects owned by Julia, i.e. objects created by jlcxx::create or returned by value from a
+// wrapped function. They are allocated through Allocator<T>::allocate and the default Finalizer<T> destroys them
+// using Allocator<T>::deallocate, so a type can opt into a pool by specializing Allocator:
+//
+//   template<> struct jlcxx::Allocator<MyType> : jlcxx::PoolAllocator<MyType> {};
+//
+// Pointers to pooled types must not be created with new and handed to Julia, so julia_owned and constructors using a
+// lambda returning a pointer are rejected for them. Custom Finalizer specializations must call Allocator<T>::deallocate.
+
+namespace jlcxx
+{
+
+struct SpecializedAllocator {};
+
+/// Default allocation policy, using new and delete
+template<typename T, typename Specializer=SpecializedAllocator>
+struct Allocator
+{
+  /// True if objects allocated with new may be passed to deallocate
+  static constexpr bool uses_operator_new = true;
+
+  template<typename... ArgsT>
+  static T* allocate(ArgsT&&... args)
+  {
+    return new T(std::forward<ArgsT>(args)...);
+  }
+
+  static void deallocate(T* to_delete)
+  {
+    delete to_delete;
+  }
+};
+
+/// Counters for the pooled objects of one type, updated by all threads
+struct AllocationStats
+{
+  std::string type_name;
+  std::size_t object_size = 0;
+  std::atomic<std::int64_t> live_objects = 0;
+  std::atomic<std::int64_t> total_allocations = 0;
+  std::atomic<std::int64_t> reserved_bytes = 0;
+};
+
+/// Add the stats to the global list. They must stay alive until the end of the program
+JLCXX_API void register_allocation_stats(const AllocationStats* stats);
+
+/// Stats of all pooled types as CSV, with columns type,object_size,live_objects,live_bytes,total_allocations,reserved_bytes
+JLCXX_API std::string allocation_stats_csv();
+
+namespace detail
+{
+  /// Free list entry, stored in place of a deallocated object
+  struct PoolNode
+  {
+    PoolNode* next;
+  };
+}
+
+/// Allocation policy using slabs of ObjectsPerSlab objects and a thread-local free list. Objects may be freed on a
+/// different thread than the one that allocated them, since slabs are never returned to the system. A thread keeps at
+/// most 2*ObjectsPerSlab free blocks: beyond that, a batch of ObjectsPerSlab blocks goes to a shared list, which is used
+/// before allocating a new slab. This bounds the memory when objects are allocated on one thread and finalized on
+/// another. The free list of an exiting thread also goes to the shared list.
+template<typename T, std::size_t ObjectsPerSlab = 256>
+struct PoolAllocator
+{
+  static_assert(ObjectsPerSlab != 0, "A slab must contain at least one object");
+
+  static constexpr bool uses_operator_new = false;
+
+  template<typename... ArgsT>
+  static T* allocate(ArgsT&&... args)
+  {
+    void* memory = pop();
+    T* result;
+    try
+    {
+      result = new(memory) T(std::forward<ArgsT>(args)...);
+    }
+    catch(...)
+    {
+      push(memory);
+      throw;
+    }
+    AllocationStats& stats = shared().stats;
+    stats.live_objects.fetch_add(1, std::memory_order_relaxed);
+    stats.total_allocations.fetch_add(1, std::memory_order_relaxed);
+    return result;
+  }
+
+  static void deallocate(T* to_delete)
+  {
+    if(to_delete == nullptr)
+    {
+      return;
+    }
+    to_delete->~T();
+    push(to_delete);
+    shared().stats.live_objects.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  static const AllocationStats& stats()
+  {
+    return shared().stats;
+  }
+
+private:
+  static constexpr std::size_t block_align = std::max(alignof(T), alignof(detail::PoolNode));
+  static constexpr std::size_t block_size = (std::max(sizeof(T), sizeof(detail::PoolNode)) + block_align - 1) / block_align * block_align;
+
+  /// Free blocks handed from one thread to another
+  struct Batch
+  {
+    detail::PoolNode* head;
+    std::size_t size;
+  };
+
+  struct Shared
+  {
+    Shared()
+    {
+      stats.type_name = typeid(T).name();
+      stats.object_size = sizeof(T);
+      register_allocation_stats(&stats);
+    }
+
+    std::mutex mutex;
+    std::vector<void*> slabs;
+    std::vector<Batch> free_batches;
+    AllocationStats stats;
+  };
+
+  struct Local
+  {
+    ~Local()
+    {
+      if(free_list == nullptr)
+      {
+        return;
+      }
+      Shared& s = shared();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.free_batches.push_back(Batch{free_list, size});
+    }
+
+    detail::PoolNode* free_list = nullptr;
+    std::size_t size = 0;
+  };
+
+  // Never destroyed, since finalizers may still run during program exit
+  static Shared& shared()
+  {
+    static Shared* s = new Shared();
+    return *s;
+  }
+
+  static Local& local()
+  {
+    static thread_local Local l;
+    return l;
+  }
+
+  static void* pop()
+  {
+    Local& l = local();
+    if(l.free_list == nullptr)
+    {
+      const Batch batch = refill();
+      l.free_list = batch.head;
+      l.size = batch.size;
+    }
+    detail::PoolNode* node = l.free_list;
+    l.free_list = node->next;
+    --l.size;
+    return node;
+  }
+
+  static void push(void* memory)
+  {
+    Local& l = local();
+    detail::PoolNode* node = static_cast<detail::PoolNode*>(memory);
+    node->next = l.free_list;
+    l.free_list = node;
+    if(++l.size == 2*ObjectsPerSlab)
+    {
+      release_batch(l);
+    }
+  }
+
+  /// Move the first ObjectsPerSlab blocks of the local free list to the shared list
+  static void release_batch(Local& l)
+  {
+    detail::PoolNode* last = l.free_list;
+    for(std::size_t i = 1; i != ObjectsPerSlab; ++i)
+    {
+      last = last->next;
+    }
+    const Batch batch{l.free_list, ObjectsPerSlab};
+    l.free_list = last->next;
+    l.size -= ObjectsPerSlab;
+    last->next = nullptr;
+
+    Shared& s = shared();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.free_batches.push_back(batch);
+  }
+
+  /// Take a batch of blocks freed by other threads, or allocate a new slab
+  static Batch refill()
+  {
+    Shared& s = shared();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if(!s.free_batches.empty())
+    {
+      const Batch batch = s.free_batches.back();
+      s.free_batches.pop_back();
+      return batch;
+    }
+
+    constexpr std::size_t slab_size = block_size * ObjectsPerSlab;
+    char* slab = static_cast<char*>(::operator new(slab_size, std::align_val_t(block_align)));
+    s.slabs.push_back(slab);
+    s.stats.reserved_bytes.fetch_add(slab_size, std::memory_order_relaxed);
+    for(std::size_t i = 0; i != ObjectsPerSlab; ++i)
+    {
+      reinterpret_cast<detail::PoolNode*>(slab + i*block_size)->next = i + 1 == ObjectsPerSlab ? nullptr : reinterpret_cast<detail::PoolNode*>(slab + (i+1)*block_size);
+    }
+    return Batch{reinterpret_cast<detail::PoolNode*>(slab), ObjectsPerSlab};
+  }
+};
+
+}
+
+#endif
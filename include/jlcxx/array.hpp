@@ -1,6 +1,10 @@
 #ifndef JLCXX_ARRAY_HPP
 #define JLCXX_ARRAY_HPP
 
+#include <cstring>
+#include <iterator>
+#include <vector>
+
 #include "type_conversion.hpp"
 #include "tuple.hpp"
 
@@ -109,6 +113,118 @@ public:
   }
 };
 
+namespace detail
+{
+
+/// True for pointers to objects on the Julia heap, which must be stored in arrays using jl_array_ptr_set
+template<typename T>
+constexpr bool is_julia_pointer_v = std::is_pointer_v<T> && (
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_value_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_datatype_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_array_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_module_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_svec_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_sym_t>);
+
+/// True if the elements between two IteratorT are contiguous values of type ValueT that can be copied using memcpy
+template<typename IteratorT, typename ValueT>
+constexpr bool is_memcpy_range_v = std::is_trivially_copyable_v<ValueT> && !std::is_same_v<ValueT, bool> && (
+  std::is_same_v<IteratorT, ValueT*> || std::is_same_v<IteratorT, const ValueT*> ||
+  std::is_same_v<IteratorT, typename std::vector<ValueT>::iterator> || std::is_same_v<IteratorT, typename std::vector<ValueT>::const_iterator>);
+
+/// Ask Julia to reserve memory for n elements
+inline void array_sizehint(jl_array_t* arr, const std::size_t n)
+{
+  static jl_value_t* sizehint = jl_get_function(jl_base_module, "sizehint!");
+  jl_value_t* boxed_n = nullptr;
+  JL_GC_PUSH2(&arr, &boxed_n);
+  boxed_n = jl_box_long(static_cast<long>(n));
+  jl_call2(sizehint, (jl_value_t*)arr, boxed_n);
+  JL_GC_POP();
+}
+
+/// Grow or shrink a 1D array to n elements
+inline void array_resize(jl_array_t* arr, const std::size_t n)
+{
+  const std::size_t len = jl_array_len(arr);
+  if(n > len)
+  {
+    jl_array_grow_end(arr, n - len);
+  }
+  else if(n < len)
+  {
+    jl_array_del_end(arr, len - n);
+  }
+}
+
+/// Write the values in [first, last) to arr starting at pos. The array must be large enough and rooted.
+/// If StoreDirectly, the array data is an array of ValueT, otherwise the values are boxed.
+template<bool StoreDirectly, typename ValueT, typename IteratorT>
+void store_range(jl_array_t* arr, std::size_t pos, IteratorT first, IteratorT last)
+{
+  if constexpr(StoreDirectly)
+  {
+    ValueT* data = jlcxx_array_data<ValueT>(arr) + pos;
+    if constexpr(is_memcpy_range_v<IteratorT, ValueT>)
+    {
+      if(first != last)
+      {
+        std::memcpy(static_cast<void*>(data), &*first, std::distance(first, last)*sizeof(ValueT));
+      }
+    }
+    else
+    {
+      std::copy(first, last, data);
+    }
+  }
+  else
+  {
+    for(; first != last; ++first, ++pos)
+    {
+      jl_array_ptr_set(arr, pos, (jl_value_t*)box<ValueT>(*first));
+    }
+  }
+}
+
+/// Construct a value at the end of arr. The array must be rooted by the caller
+template<bool StoreDirectly, typename ValueT, typename... ArgsT>
+void emplace_back_unchecked(jl_array_t* arr, ArgsT&&... args)
+{
+  const std::size_t pos = jl_array_len(arr);
+  jl_array_grow_end(arr, 1);
+  if constexpr(StoreDirectly)
+  {
+    new(jlcxx_array_data<ValueT>(arr) + pos) ValueT(std::forward<ArgsT>(args)...);
+  }
+  else
+  {
+    jl_array_ptr_set(arr, pos, (jl_value_t*)box<ValueT>(ValueT(std::forward<ArgsT>(args)...)));
+  }
+}
+
+/// Append [first, last) to arr, growing it once if the distance is known up front
+template<bool StoreDirectly, typename ValueT, typename IteratorT>
+void append_range(jl_array_t* arr, IteratorT first, IteratorT last)
+{
+  using category_t = typename std::iterator_traits<IteratorT>::iterator_category;
+  if constexpr(std::is_base_of_v<std::forward_iterator_tag, category_t>)
+  {
+    const std::size_t pos = jl_array_len(arr);
+    jl_array_grow_end(arr, std::distance(first, last));
+    store_range<StoreDirectly, ValueT>(arr, pos, first, last);
+  }
+  else
+  {
+    for(; first != last; ++first)
+    {
+      emplace_back_unchecked<StoreDirectly, ValueT>(arr, *first);
+    }
+  }
+}
+
+
+}
+
 /// Wrap a Julia 1D array in a C++ class. Array is allocated on the C++ side
 template<typename ValueT>
 class Array
@@ -148,6 +264,42 @@ public:
     JL_GC_POP();
   }
 
+  std::size_t size() const
+  {
+    return jl_array_len(m_array);
+  }
+
+  /// Reserve memory for n elements, so growing the array up to that size doesn't reallocate
+  void reserve(const std::size_t n)
+  {
+    detail::array_sizehint(m_array, n);
+  }
+
+  /// Change the number of elements. New elements are zero, or undefined references for boxed element types
+  void resize(const std::size_t n)
+  {
+    JL_GC_PUSH1(&m_array);
+    detail::array_resize(m_array, n);
+    JL_GC_POP();
+  }
+
+  /// Append the elements in [first, last), growing the array once for forward iterators
+  template<typename IteratorT>
+  void append(IteratorT first, IteratorT last)
+  {
+    JL_GC_PUSH1(&m_array);
+    detail::append_range<stores_directly, ValueT>(m_array, first, last);
+    JL_GC_POP();
+  }
+
+  /// Construct an element at the end, without pushing a GC frame. The array must be rooted by the caller, e.g. using
+  /// gc_pointer() or protect_from_gc, and space should be reserved when appending many elements
+  template<typename... ArgsT>
+  void emplace_back_unchecked(ArgsT&&... args)
+  {
+    detail::emplace_back_unchecked<stores_directly, ValueT>(m_array, std::forward<ArgsT>(args)...);
+  }
+
   /// Access to the wrapped array
   jl_array_t* wrapped()
   {
@@ -161,6 +313,9 @@ public:
   }
 
 private:
+  // Mirrored non-pointer types are stored in the array data, others are boxed
+  static constexpr bool stores_directly = jlcxx::IsMirroredType<ValueT>::value && !std::is_pointer_v<ValueT>;
+
   jl_array_t* m_array;
 };
 
@@ -201,6 +356,9 @@ public:
   template<typename... SizesT>
   ArrayRef(const bool julia_owned, julia_t* ptr, const SizesT... sizes);
 
+  /// Take over the storage of a vector without copying. The vector is destroyed when the Julia array is finalized
+  explicit ArrayRef(std::vector<ValueT>&& v);
+
   typedef array_iterator_base<julia_t, ValueT> iterator;
   typedef array_iterator_base<julia_t const, ValueT const> const_iterator;
 
@@ -241,6 +399,45 @@ public:
     JL_GC_POP();
   }
 
+  /// Reserve memory for n elements, so growing the array up to that size doesn't reallocate
+  void reserve(const std::size_t n)
+  {
+    static_assert(Dim == 1, "ArrayRef::reserve is only for 1D ArrayRef");
+    detail::array_sizehint(wrapped(), n);
+  }
+
+  /// Change the number of elements. New elements are zero, or undefined references for arrays of Julia objects
+  void resize(const std::size_t n)
+  {
+    static_assert(Dim == 1, "ArrayRef::resize is only for 1D ArrayRef");
+    jl_array_t* arr_ptr = wrapped();
+    JL_GC_PUSH1(&arr_ptr);
+    detail::array_resize(arr_ptr, n);
+    JL_GC_POP();
+  }
+
+  /// Append the elements in [first, last), growing the array once for forward iterators
+  template<typename IteratorT>
+  void append(IteratorT first, IteratorT last)
+  {
+    static_assert(Dim == 1, "ArrayRef::append is only for 1D ArrayRef");
+    static_assert(std::is_same_v<julia_t,ValueT>, "ArrayRef::append is only for arrays of fundamental types or Julia objects");
+    jl_array_t* arr_ptr = wrapped();
+    JL_GC_PUSH1(&arr_ptr);
+    detail::append_range<!detail::is_julia_pointer_v<ValueT>, ValueT>(arr_ptr, first, last);
+    JL_GC_POP();
+  }
+
+  /// Construct an element at the end, without pushing a GC frame. The array must be rooted by the caller, and space
+  /// should be reserved when appending many elements
+  template<typename... ArgsT>
+  void emplace_back_unchecked(ArgsT&&... args)
+  {
+    static_assert(Dim == 1, "ArrayRef::emplace_back_unchecked is only for 1D ArrayRef");
+    static_assert(std::is_same_v<julia_t,ValueT>, "ArrayRef::emplace_back_unchecked is only for arrays of fundamental types or Julia objects");
+    detail::emplace_back_unchecked<!detail::is_julia_pointer_v<ValueT>, ValueT>(wrapped(), std::forward<ArgsT>(args)...);
+  }
+
   const julia_t* data() const
   {
     return jlcxx_array_data<julia_t>(wrapped());
@@ -365,6 +562,56 @@ ArrayRef<ValueT, Dim>::ArrayRef(const bool julia_owned, julia_t* c_ptr, const Si
 {
 }
 
+/// Keep owner alive until the data of arr is unreachable, and then call release(owner). Used for arrays pointing to
+/// memory that must be freed by C++, since Julia can only free memory allocated with malloc when it owns an array.
+/// On Julia 1.11 and later the finalizer is attached to the Memory of arr, which is shared by aliases such as reshape.
+JLCXX_API void attach_array_owner(jl_array_t* arr, void* owner, void (*release)(void*));
+
+namespace detail
+{
+  template<typename ValueT>
+  void release_vector(void* v)
+  {
+    std::vector<ValueT>* to_delete = static_cast<std::vector<ValueT>*>(v);
+    report_external_free(to_delete->capacity()*sizeof(ValueT));
+    delete to_delete;
+  }
+
+  /// Wrap the storage of v in a Julia vector. The vector is moved to the heap and deleted when the array is finalized.
+  template<typename ValueT>
+  jl_array_t* wrap_vector(std::vector<ValueT>&& v)
+  {
+    static_assert(IsMirroredType<ValueT>::value && !std::is_pointer_v<ValueT>, "Only vectors of types with the same layout in C++ and Julia can be converted without copying");
+    static_assert(!std::is_same_v<ValueT, bool>, "std::vector<bool> has no contiguous storage, copy it into an Array<bool> instead");
+    jl_value_t* array_type = (jl_value_t*)julia_type<ArrayRef<ValueT,1>>();
+    if(v.empty())
+    {
+      return jl_alloc_array_1d(array_type, 0);
+    }
+
+    std::vector<ValueT>* owner = new std::vector<ValueT>(std::move(v));
+    jl_array_t* result = jl_ptr_to_array_1d(array_type, owner->data(), owner->size(), 0);
+    JL_GC_PUSH1(&result);
+    attach_array_owner(result, owner, release_vector<ValueT>);
+    report_external_allocation(owner->capacity()*sizeof(ValueT));
+    JL_GC_POP();
+    return result;
+  }
+}
+
+template<typename ValueT, int Dim>
+ArrayRef<ValueT, Dim>::ArrayRef(std::vector<ValueT>&& v) : m_array(detail::wrap_vector(std::move(v)))
+{
+  static_assert(Dim == 1, "Only 1D ArrayRef can be constructed from a vector");
+}
+
+/// Return the contents of v as a Julia Array without copying, e.g. from a wrapped function returning a std::vector
+template<typename ValueT>
+ArrayRef<ValueT, 1> to_julia_array(std::vector<ValueT>&& v)
+{
+  return ArrayRef<ValueT, 1>(std::move(v));
+}
+
 template<typename ValueT, typename... SizesT>
 auto make_julia_array(ValueT* c_ptr, const SizesT... sizes) -> ArrayRef<ValueT, sizeof...(SizesT)>
 {
@@ -52,6 +52,17 @@ enum class calling_policy : bool
 /// default value for the calling_policy argument for Module::method with raw C++ function pointers
 constexpr auto default_calling_policy = calling_policy::ccall;
 
+/// Tag for Module::method and TypeWrapper::method, indicating that the wrapped function never throws.
+/// Use as jlcxx::noexcept_call on noexcept functions to skip the translation of C++ exceptions into Julia errors on each call.
+/// Exceptions from converting the arguments, e.g. for a deleted C++ object, are still translated.
+struct noexcept_call_t {};
+constexpr noexcept_call_t noexcept_call{};
+
+/// Tag for Module::method and TypeWrapper::method, indicating that the wrapped function may run while the Julia GC is active.
+/// Use as jlcxx::gc_safe for long-running functions that don't touch Julia objects, so they don't hold up collections on other threads.
+struct gc_safe_t {};
+constexpr gc_safe_t gc_safe{};
+
 /// enum for finalize parameter for constructors
 enum class finalize_policy : bool
 {
@@ -132,6 +143,24 @@ namespace detail
     }
   };
 
+  /// noexcept_call changes the generated call wrapper, so it is handled at compile time (see CallOptions)
+  template<>
+  struct process_attribute<noexcept_call_t>
+  {
+    static inline void init(noexcept_call_t, ExtraFunctionData&)
+    {
+    }
+  };
+
+  /// gc_safe changes the generated call wrapper, so it is handled at compile time (see CallOptions)
+  template<>
+  struct process_attribute<gc_safe_t>
+  {
+    static inline void init(gc_safe_t, ExtraFunctionData&)
+    {
+    }
+  };
+
   template<typename T>
   void parse_attributes_helper(ExtraFunctionData& f, T argi)
   {
@@ -168,6 +197,18 @@ namespace detail
   static_assert(count_attributes<float, int, float, int, double>() == 1);
   static_assert(count_attributes<int, int, float, int, double, int, int>() == 4);
 
+  /// Options selecting the variant of the generated call wrapper, which must be known at compile time
+  template<bool TranslateExceptions = true, bool GCSafe = false>
+  struct CallOptions
+  {
+    static constexpr bool translate_exceptions = TranslateExceptions;
+    static constexpr bool gc_safe = GCSafe;
+  };
+
+  /// Call options derived from the types of the extra attributes passed to method
+  template<typename... Extra>
+  using call_options_t = CallOptions<count_attributes<noexcept_call_t, Extra...>() == 0, count_attributes<gc_safe_t, Extra...>() != 0>;
+
   /// check number of arguments matches annotated arguments if annotations for keyword arguments are present
   template<typename...  Extra>
   constexpr bool check_extra_argument_count(int n_arg)
@@ -2,11 +2,13 @@
 #define JLCXX_MODULE_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <sstream>
+#include <tuple>
 #include <typeinfo>
 #include <vector>
 
@@ -35,8 +37,108 @@ JLCXX_API jl_datatype_t* new_bitstype(jl_sym_t *name,
 namespace detail
 {
 
-// Need to treat void specially
+/// RAII guard putting the current thread in a GC-safe state, so the Julia GC can run on other threads meanwhile
+class GCSafeRegion
+{
+public:
+  GCSafeRegion() :
+    m_ptls(current_ptls()),
+    m_state(jl_gc_safe_enter(m_ptls))
+  {
+  }
+
+  ~GCSafeRegion()
+  {
+    jl_gc_safe_leave(m_ptls, m_state);
+  }
+
+  GCSafeRegion(const GCSafeRegion&) = delete;
+  GCSafeRegion& operator=(const GCSafeRegion&) = delete;
+
+private:
+  jl_ptls_t m_ptls;
+  int8_t m_state;
+};
+
+/// True for types referring to memory owned by Julia, which must not be touched in a GC-safe region
+template<typename T>
+struct IsJuliaHeapType : std::bool_constant<std::is_pointer_v<T> && (
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_value_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_datatype_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_array_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_module_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_svec_t> ||
+  std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, jl_sym_t>)>
+{
+};
+
+template<typename ValueT, int Dim>
+struct IsJuliaHeapType<ArrayRef<ValueT, Dim>> : std::true_type {};
+
+template<typename ValueT>
+struct IsJuliaHeapType<Array<ValueT>> : std::true_type {};
+
+template<typename T>
+struct IsJuliaHeapType<BoxedValue<T>> : std::true_type {};
+
+/// Check that a function marked with jlcxx::gc_safe doesn't take or return Julia objects
+template<typename OptionsT, typename R, typename... Args>
+constexpr void check_gc_safe_call()
+{
+  static_assert(!OptionsT::gc_safe || !(IsJuliaHeapType<std::remove_cv_t<std::remove_reference_t<R>>>::value || (IsJuliaHeapType<std::remove_cv_t<std::remove_reference_t<Args>>>::value || ...)),
+    "Functions wrapped using jlcxx::gc_safe can't use jl_value_t*, ArrayRef or other Julia objects in their signature");
+}
+
+/// Call f with already converted arguments. With jlcxx::noexcept_call this frame is noexcept, so an exception from f
+/// terminates instead of unwinding through the Julia frames. Argument and result conversions stay outside of it.
+template<typename OptionsT, typename FunctorT, typename... CppArgsT>
+inline decltype(auto) invoke_wrapped(const FunctorT& f, CppArgsT&&... args) noexcept(!OptionsT::translate_exceptions)
+{
+  return f(std::forward<CppArgsT>(args)...);
+}
+
+/// True if converting the arguments and the result can't throw, because they are passed between Julia and C++ unchanged
 template<typename R, typename... Args>
+constexpr bool is_nothrow_conversion_v = (std::is_void_v<R> || std::is_arithmetic_v<R>) && (std::is_arithmetic_v<Args> && ...);
+
+/// Convert the arguments, call f and convert the result. With gc_safe, the call runs in a GC-safe region
+/// entered after the arguments are converted and left before the result is boxed.
+template<typename OptionsT, typename R, typename... Args, typename FunctorT>
+inline auto call_converted(const FunctorT& f, static_julia_type<Args>... args) -> decltype(convert_to_julia(std::declval<R>()))
+{
+  if constexpr (!OptionsT::gc_safe)
+  {
+    return convert_to_julia(invoke_wrapped<OptionsT>(f, convert_to_cpp<Args>(args)...));
+  }
+  else
+  {
+    std::tuple<decltype(convert_to_cpp<Args>(args))...> cpp_args(convert_to_cpp<Args>(args)...);
+    auto&& result = [&]() -> decltype(auto)
+    {
+      GCSafeRegion gc_safe_region;
+      return std::apply([&f] (auto&&... a) -> decltype(auto) { return invoke_wrapped<OptionsT>(f, std::forward<decltype(a)>(a)...); }, std::move(cpp_args));
+    }();
+    return convert_to_julia(std::forward<decltype(result)>(result));
+  }
+}
+
+template<typename OptionsT, typename... Args, typename FunctorT>
+inline void call_converted_void(const FunctorT& f, static_julia_type<Args>... args)
+{
+  if constexpr (!OptionsT::gc_safe)
+  {
+    invoke_wrapped<OptionsT>(f, convert_to_cpp<Args>(args)...);
+  }
+  else
+  {
+    std::tuple<decltype(convert_to_cpp<Args>(args))...> cpp_args(convert_to_cpp<Args>(args)...);
+    GCSafeRegion gc_safe_region;
+    std::apply([&f] (auto&&... a) { invoke_wrapped<OptionsT>(f, std::forward<decltype(a)>(a)...); }, std::move(cpp_args));
+  }
+}
+
+// Need to treat void specially
+template<typename OptionsT, typename R, typename... Args>
 struct ReturnTypeAdapter
 {
   using return_type = decltype(convert_to_julia(std::declval<R>()));
@@ -45,42 +147,127 @@ struct ReturnTypeAdapter
   {
     auto std_func = reinterpret_cast<const std::function<R(Args...)>*>(functor);
     assert(std_func != nullptr);
-    return convert_to_julia((*std_func)(convert_to_cpp<Args>(args)...));
+    return call_converted<OptionsT, R, Args...>(*std_func, args...);
   }
 };
 
-template<typename... Args>
-struct ReturnTypeAdapter<void, Args...>
+template<typename OptionsT, typename... Args>
+struct ReturnTypeAdapter<OptionsT, void, Args...>
 {
   inline void operator()(const void* functor, static_julia_type<Args>... args)
   {
     auto std_func = reinterpret_cast<const std::function<void(Args...)>*>(functor);
     assert(std_func != nullptr);
-    (*std_func)(convert_to_cpp<Args>(args)...);
+    call_converted_void<OptionsT, Args...>(*std_func, args...);
   }
 };
 
 /// Call a C++ std::function, passed as a void pointer since it comes from Julia
-template<typename R, typename... Args>
+/// A collection requested through report_external_allocation runs first, while the arguments are rooted by the caller.
+/// C++ exceptions are rethrown as Julia errors. With jlcxx::noexcept_call the function itself can't throw, so the
+/// translation is only skipped if the argument and result conversions can't throw either.
+template<typename OptionsT, typename R, typename... Args>
 struct CallFunctor
 {
-  using return_type = std::remove_const_t<decltype(ReturnTypeAdapter<R, Args...>()(std::declval<const void*>(), std::declval<static_julia_type<Args>>()...))>;
+  using return_type = std::remove_const_t<decltype(ReturnTypeAdapter<OptionsT, R, Args...>()(std::declval<const void*>(), std::declval<static_julia_type<Args>>()...))>;
+  static constexpr bool translate_exceptions = OptionsT::translate_exceptions || !is_nothrow_conversion_v<R, Args...>;
+
+  static return_type apply(const void* functor, static_julia_type<Args>... args) noexcept(!translate_exceptions)
+  {
+    collect_if_requested();
+    if constexpr (translate_exceptions)
+    {
+      try
+      {
+        return ReturnTypeAdapter<OptionsT, R, Args...>()(functor, args...);
+      }
+      catch(const std::exception& err)
+      {
+        jl_error(err.what());
+      }
+
+      return return_type();
+    }
+    else
+    {
+      return ReturnTypeAdapter<OptionsT, R, Args...>()(functor, args...);
+    }
+  }
+};
+
+/// Call a stateless functor directly. FunctorT is default-constructed on each call, so no thunk is needed
+template<typename OptionsT, typename FunctorT, typename R, typename... Args>
+struct DirectReturnTypeAdapter
+{
+  using return_type = decltype(convert_to_julia(std::declval<R>()));
+
+  inline return_type operator()(static_julia_type<Args>... args)
+  {
+    return call_converted<OptionsT, R, Args...>(FunctorT(), args...);
+  }
+};
+
+template<typename OptionsT, typename FunctorT, typename... Args>
+struct DirectReturnTypeAdapter<OptionsT, FunctorT, void, Args...>
+{
+  inline void operator()(static_julia_type<Args>... args)
+  {
+    call_converted_void<OptionsT, Args...>(FunctorT(), args...);
+  }
+};
+
+/// Static trampoline for a stateless functor, called from Julia without a thunk argument. Exceptions are handled as in CallFunctor
+template<typename OptionsT, typename FunctorT, typename R, typename... Args>
+struct CallDirectFunctor
+{
+  using return_type = std::remove_const_t<decltype(DirectReturnTypeAdapter<OptionsT, FunctorT, R, Args...>()(std::declval<static_julia_type<Args>>()...))>;
+  static constexpr bool translate_exceptions = OptionsT::translate_exceptions || !is_nothrow_conversion_v<R, Args...>;
 
-  static return_type apply(const void* functor, static_julia_type<Args>... args)
+  static return_type apply(static_julia_type<Args>... args) noexcept(!translate_exceptions)
   {
-    try
+    collect_if_requested();
+    if constexpr (translate_exceptions)
     {
-      return ReturnTypeAdapter<R, Args...>()(functor, args...);
+      try
+      {
+        return DirectReturnTypeAdapter<OptionsT, FunctorT, R, Args...>()(args...);
+      }
+      catch(const std::exception& err)
+      {
+        jl_error(err.what());
+      }
+
+      return return_type();
     }
-    catch(const std::exception& err)
+    else
     {
-      jl_error(err.what());
+      return DirectReturnTypeAdapter<OptionsT, FunctorT, R, Args...>()(args...);
     }
+  }
+};
 
-    return return_type();
+/// Stateless functor calling the function or member function pointer F, which is known at compile time
+template<auto F, typename R, typename... Args>
+struct StaticFunctor
+{
+  R operator()(Args... args) const noexcept(std::is_nothrow_invocable_v<decltype(F), Args...>)
+  {
+    return std::invoke(F, std::forward<Args>(args)...);
   }
 };
 
+/// Check that a functor marked with jlcxx::noexcept_call is declared noexcept
+template<typename OptionsT, typename FunctorT, typename... Args>
+constexpr void check_noexcept_call()
+{
+  static_assert(OptionsT::translate_exceptions || std::is_nothrow_invocable_v<const FunctorT&, Args...>, "Functions wrapped using jlcxx::noexcept_call must be declared noexcept");
+}
+
+/// True if the functor has no state and can be created at will, so it can be called through a static trampoline.
+/// This is the case for lambdas without captures (from C++20 on)
+template<typename FunctorT>
+constexpr bool is_stateless_functor_v = std::is_empty_v<FunctorT> && std::is_trivially_default_constructible_v<FunctorT>;
+
 /// Make a vector with the types in the variadic template parameter pack
 template<typename... Args>
 std::vector<jl_datatype_t*> argtype_vector()
@@ -120,10 +307,15 @@ BoxedValue<T> create(ArgsT&&... args)
   jl_datatype_t* dt = julia_type<T>();
   assert(jl_is_mutable_datatype(dt));
 
-
-  T* cpp_obj = new T(std::forward<ArgsT>(args)...);
-
-  return boxed_cpp_pointer(cpp_obj, dt, finalize);
+  if constexpr(InlineStorage<T>::value)
+  {
+    return boxed_cpp_inline<T>(dt, std::forward<ArgsT>(args)...);
+  }
+  else
+  {
+    T* cpp_obj = Allocator<T>::allocate(std::forward<ArgsT>(args)...);
+    return boxed_cpp_pointer(cpp_obj, dt, finalize);
+  }
 }
 
 /// Safe upcast to base type
@@ -146,21 +338,41 @@ class JLCXX_API Module;
 class JLCXX_API FunctionWrapperBase
 {
 public:
+  using return_type_resolver_t = std::pair<jl_datatype_t*,jl_datatype_t*>(*)();
+
   FunctionWrapperBase(Module* mod, std::pair<jl_datatype_t*,jl_datatype_t*> return_type);
 
+  /// Construct with a function that creates and returns the return type, called right away unless the module uses lazy registration
+  FunctionWrapperBase(Module* mod, return_type_resolver_t return_type_resolver);
+
   /// Types of the arguments (used in the wrapper signature)
   virtual std::vector<jl_datatype_t*> argument_types() const = 0;
 
   /// Return type
-  std::pair<jl_datatype_t*,jl_datatype_t*> return_type() const { return m_return_type; }
+  std::pair<jl_datatype_t*,jl_datatype_t*> return_type() const
+  {
+    if(m_return_type_resolver != nullptr)
+    {
+      m_return_type = m_return_type_resolver();
+      m_return_type_resolver = nullptr;
+    }
+    return m_return_type;
+  }
 
-  void set_return_type(std::pair<jl_datatype_t*,jl_datatype_t*> dt) { m_return_type = dt; }
+  void set_return_type(std::pair<jl_datatype_t*,jl_datatype_t*> dt)
+  {
+    m_return_type = dt;
+    m_return_type_resolver = nullptr;
+  }
+
+  /// True if the Julia types used by this function are only created when they are first needed
+  bool lazy() const;
 
   virtual ~FunctionWrapperBase() {}
 
   inline void set_name(jl_value_t* name)
   {
-    protect_from_gc(name);
+    protect_from_gc_permanent(name);
     m_name = name;
   }
 
@@ -171,12 +383,24 @@ public:
 
   inline void set_doc(jl_value_t* doc)
   {
-    protect_from_gc(doc);
+    protect_from_gc_permanent(doc);
     m_doc = doc;
   }
 
+  /// Set the docstring, which is only converted to a Julia string when it is first requested
+  inline void set_doc(std::string doc)
+  {
+    m_doc = nullptr;
+    m_doc_string = std::move(doc);
+  }
+
   inline jl_value_t* doc() const
   {
+    if(m_doc == nullptr)
+    {
+      m_doc = jl_cstr_to_string(m_doc_string.c_str());
+      protect_from_gc_permanent(m_doc);
+    }
     return m_doc;
   }
 
@@ -184,15 +408,13 @@ public:
   {
     m_number_of_keyword_args = kwArgs.size();
 
-    // gather all argument names
+    // gather all argument names, converted to Julia strings on first use
     m_argument_names.clear();
+    m_argument_name_strings.clear();
     for(auto& a: posArgs)
-      m_argument_names.push_back(jl_cstr_to_string(a.name));
+      m_argument_name_strings.push_back(a.name);
     for(auto& a: kwArgs)
-      m_argument_names.push_back(jl_cstr_to_string(a.name));
-    // ensure the Julia GC doesn't throw away our strings:
-    for(auto& s: m_argument_names)
-      protect_from_gc(s);
+      m_argument_name_strings.push_back(a.name);
 
     // gather all default values
     m_argument_default_values.clear();
@@ -202,7 +424,20 @@ public:
       m_argument_default_values.push_back(a.defaultValue);
   }
 
-  const std::vector<jl_value_t*>& argument_names() const {return m_argument_names;}
+  const std::vector<jl_value_t*>& argument_names() const
+  {
+    if(m_argument_names.size() != m_argument_name_strings.size())
+    {
+      m_argument_names.clear();
+      for(const std::string& name : m_argument_name_strings)
+      {
+        m_argument_names.push_back(jl_cstr_to_string(name.c_str()));
+        // ensure the Julia GC doesn't throw away our strings:
+        protect_from_gc_permanent(m_argument_names.back());
+      }
+    }
+    return m_argument_names;
+  }
   int number_of_keyword_arguments() const {return m_number_of_keyword_args;}
   const std::vector<jl_value_t*>& argument_default_values() const {return m_argument_default_values;}
 
@@ -217,12 +452,15 @@ public:
 
 private:
   jl_value_t* m_name = nullptr;
-  jl_value_t* m_doc = nullptr;
-  std::vector<jl_value_t*> m_argument_names;
+  mutable jl_value_t* m_doc = nullptr;
+  std::string m_doc_string;
+  mutable std::vector<jl_value_t*> m_argument_names;
+  std::vector<std::string> m_argument_name_strings;
   int m_number_of_keyword_args = 0;
   std::vector<jl_value_t*> m_argument_default_values;
   Module* m_module;
-  std::pair<jl_datatype_t*,jl_datatype_t*> m_return_type = std::make_pair(nullptr,nullptr);
+  mutable std::pair<jl_datatype_t*,jl_datatype_t*> m_return_type = std::make_pair(nullptr,nullptr);
+  mutable return_type_resolver_t m_return_type_resolver = nullptr;
 
   // The module in which the function is overridden, e.g. jl_base_module when trying to override Base.getindex.
   jl_value_t* m_override_module = nullptr;
@@ -236,20 +474,28 @@ class FunctionWrapper : public FunctionWrapperBase
 public:
   typedef std::function<R(Args...)> functor_t;
 
-  FunctionWrapper(Module* mod, const functor_t &function) : FunctionWrapperBase(mod, julia_return_type<R>()), m_function(function)
+  template<typename OptionsT = detail::CallOptions<>>
+  FunctionWrapper(Module* mod, const functor_t &function, OptionsT = OptionsT()) :
+    FunctionWrapperBase(mod, julia_return_type<R>),
+    m_function(function),
+    m_pointer(reinterpret_cast<void*>(detail::CallFunctor<OptionsT, R, Args...>::apply))
   {
-    (create_if_not_exists<Args>(), ...);
+    if(!lazy())
+    {
+      (create_if_not_exists<Args>(), ...);
+    }
   }
 
   virtual std::vector<jl_datatype_t*> argument_types() const
   {
+    (create_if_not_exists<Args>(), ...);
     return detail::argtype_vector<Args...>();
   }
 
 protected:
   virtual void* pointer()
   {
-    return reinterpret_cast<void*>(detail::CallFunctor<R, Args...>::apply);
+    return m_pointer;
   }
 
   virtual void* thunk()
@@ -259,6 +505,7 @@ protected:
 
 private:
   functor_t m_function;
+  void* m_pointer;
 };
 
 /// Implementation of function storage, case of a function pointer
@@ -268,13 +515,17 @@ class FunctionPtrWrapper : public FunctionWrapperBase
 public:
   typedef std::function<R(Args...)> functor_t;
 
-  FunctionPtrWrapper(Module* mod, R (*f)(Args...)) : FunctionWrapperBase(mod, julia_return_type<R>()), m_function(f)
+  FunctionPtrWrapper(Module* mod, R (*f)(Args...)) : FunctionWrapperBase(mod, julia_return_type<R>), m_function(f)
   {
-    (create_if_not_exists<Args>(), ...);
+    if(!lazy())
+    {
+      (create_if_not_exists<Args>(), ...);
+    }
   }
 
   virtual std::vector<jl_datatype_t*> argument_types() const
   {
+    (create_if_not_exists<Args>(), ...);
     return detail::argtype_vector<Args...>();
   }
 
@@ -293,6 +544,43 @@ private:
   R(*m_function)(Args...);
 };
 
+/// Implementation of function storage, case of a stateless functor that is called through a static trampoline
+template<typename FunctorT, typename R, typename... Args>
+class StaticFunctionWrapper : public FunctionWrapperBase
+{
+public:
+  template<typename OptionsT = detail::CallOptions<>>
+  StaticFunctionWrapper(Module* mod, OptionsT = OptionsT()) :
+    FunctionWrapperBase(mod, julia_return_type<R>),
+    m_pointer(reinterpret_cast<void*>(detail::CallDirectFunctor<OptionsT, FunctorT, R, Args...>::apply))
+  {
+    if(!lazy())
+    {
+      (create_if_not_exists<Args>(), ...);
+    }
+  }
+
+  virtual std::vector<jl_datatype_t*> argument_types() const
+  {
+    (create_if_not_exists<Args>(), ...);
+    return detail::argtype_vector<Args...>();
+  }
+
+protected:
+  virtual void* pointer()
+  {
+    return m_pointer;
+  }
+
+  virtual void* thunk()
+  {
+    return nullptr;
+  }
+
+private:
+  void* m_pointer;
+};
+
 /// Indicate that a parametric type is to be added
 template<typename... ParametersT>
 struct Parametric
@@ -370,7 +658,7 @@ inline jl_value_t* make_fname(const std::string& nametype, ArgsT... args)
   jl_value_t* name = nullptr;
   JL_GC_PUSH1(&name);
   name = jl_new_struct((jl_datatype_t*)julia_type(nametype), args...);
-  protect_from_gc(name);
+  protect_from_gc_permanent(name);
   JL_GC_POP();
 
   return name;
@@ -539,7 +827,7 @@ public:
   void append_function(FunctionWrapperBase* f)
   {
     assert(f != nullptr);
-    m_functions.push_back(std::shared_ptr<FunctionWrapperBase>(f));
+    m_functions.emplace_back(f);
     assert(m_functions.back() != nullptr);
     if(m_override_module != nullptr)
     {
@@ -553,8 +841,9 @@ public:
   {
     static_assert(detail::check_extra_argument_count<Extra...>(sizeof...(Args)), "Wrong number of annotated arguments (jlcxx::arg and jlcxx::kwarg arguments)!");
 
+    profiling::Scope profile_scope("method", name);
     detail::ExtraFunctionData extraData = detail::parse_attributes(extra...);
-    return method_helper(name, f, extraData);
+    return method_helper<detail::call_options_t<Extra...>>(name, f, std::move(extraData));
   }
 
   /// Define a new function. Overload for pointers
@@ -563,22 +852,28 @@ public:
   {
     static_assert(detail::check_extra_argument_count<Extra...>(sizeof...(Args)), "Wrong number of annotated arguments (jlcxx::arg and jlcxx::kwarg arguments)!");
 
+    profiling::Scope profile_scope("method", name);
     detail::ExtraFunctionData extraData = detail::parse_attributes<true>(extra...);
-    const bool need_convert = bool(extraData.force_convert) || detail::NeedConvertHelper<R, Args...>()();
+    // A GC-safe region can only be entered from a wrapper, so gc_safe also selects the std::function calling method
+    const bool need_convert = detail::call_options_t<Extra...>::gc_safe || bool(extraData.force_convert) || detail::NeedConvertHelper<R, Args...>()();
 
     // Conversion is automatic when using the std::function calling method, so if we need conversion we use that
     if(need_convert)
     {
-      return method_helper(name, std::function<R(Args...)>(f), std::move(extraData));
+      return method_helper<detail::call_options_t<Extra...>>(name, std::function<R(Args...)>(f), std::move(extraData));
     }
 
     // No conversion needed -> call can be through a naked function pointer
-    auto* new_wrapper = new FunctionPtrWrapper<R, Args...>(this, f);
-    new_wrapper->set_name((jl_value_t*)jl_symbol(name.c_str()));
-    new_wrapper->set_doc(jl_cstr_to_string(extraData.doc.c_str()));
-    new_wrapper->set_extra_argument_data(std::move(extraData.positionalArguments), std::move(extraData.keywordArguments));
-    append_function(new_wrapper);
-    return *new_wrapper;
+    return add_function_wrapper(new FunctionPtrWrapper<R, Args...>(this, f), name, std::move(extraData));
+  }
+
+  /// Define a new function from a function pointer that is known at compile time, e.g. mod.method<&f>("f").
+  /// If conversion is needed, the call goes through a static trampoline instead of a std::function
+  template<auto F, typename... Extra>
+  FunctionWrapperBase& method(const std::string& name, Extra... extra)
+  {
+    profiling::Scope profile_scope("method", name);
+    return static_method_helper<F>(name, F, extra...);
   }
 
   /// Define a new function. Overload for lambda
@@ -586,8 +881,9 @@ public:
            std::enable_if_t<detail::has_call_operator<LambdaT>::value && !std::is_member_function_pointer_v<LambdaT>, bool> = true>
   FunctionWrapperBase& method(const std::string& name, LambdaT&& lambda, Extra... extra)
   {
+    profiling::Scope profile_scope("method", name);
     detail::ExtraFunctionData extraData = detail::parse_attributes(extra...);
-    return lambda_helper(name, std::forward<LambdaT>(lambda), &LambdaT::operator(), std::move(extraData));
+    return lambda_helper<detail::call_options_t<Extra...>>(name, std::forward<LambdaT>(lambda), &LambdaT::operator(), std::move(extraData));
   }
 
   /// Add a constructor with the given argument types for the given datatype (used to get the name)
@@ -599,7 +895,7 @@ public:
     detail::ExtraFunctionData extraData = detail::parse_attributes<false,true>(extra...);
     FunctionWrapperBase &new_wrapper = bool(extraData.finalize) ? add_lambda("dummy", [](ArgsT... args) { return create<T, true>(args...); }, std::move(extraData)) : add_lambda("dummy", [](ArgsT... args) { return create<T, false>(args...); }, std::move(extraData));
     new_wrapper.set_name(detail::make_fname("ConstructorFname", dt));
-    new_wrapper.set_doc(jl_cstr_to_string(extraData.doc.c_str()));
+    new_wrapper.set_doc(extraData.doc);
     new_wrapper.set_extra_argument_data(std::move(extraData.positionalArguments), std::move(extraData.keywordArguments));
   }
 
@@ -607,6 +903,8 @@ public:
   void constructor(jl_datatype_t* dt, LambdaT&& lambda, R(LambdaT::*)(ArgsT...) const, Extra... extra)
   {
     static_assert(std::is_same_v<T*,R>, "Constructor lambda function must return a pointer to the constructed object, of the correct type");
+    static_assert(Allocator<T>::uses_operator_new, "Constructor lambdas returning a pointer are not supported for types with a custom Allocator");
+    static_assert(!InlineStorage<T>::value, "Constructor lambdas returning a pointer are not supported for types with InlineStorage");
     detail::ExtraFunctionData extraData = detail::parse_attributes<false,true>(extra...);
     FunctionWrapperBase &new_wrapper = add_lambda("dummy", [=](ArgsT... args)
     {
@@ -622,23 +920,11 @@ public:
   template<typename F>
   void for_each_function(const F f) const
   {
-    auto funcs_copy = m_functions;
-    for(const auto &item : funcs_copy)
+    // The wrappers themselves never move, so iterating by index also visits any functions added during the loop
+    for(std::size_t i = 0; i != m_functions.size(); ++i)
     {
-      assert(item != nullptr);
-      f(*item);
-    }
-    // Account for any new functions added during the loop
-    while(funcs_copy.size() != m_functions.size())
-    {
-      const std::size_t oldsize = funcs_copy.size();
-      const std::size_t newsize = m_functions.size();
-      funcs_copy = m_functions;
-      for(std::size_t i = oldsize; i != newsize; ++i)
-      {
-        assert(funcs_copy[i] != nullptr);
-        f(*funcs_copy[i]);
-      }
+      assert(m_functions[i] != nullptr);
+      f(*m_functions[i]);
     }
   }
 
@@ -720,6 +1006,29 @@ public:
     return module_name(m_jl_mod);
   }
 
+  /// In lazy registration mode, the Julia types used by functions are only created when the function table is requested,
+  /// and docstrings and argument names are converted when first used. Off by default, or set with JLCXX_LAZY_REGISTRATION=1
+  void set_lazy_registration(const bool lazy)
+  {
+    m_lazy_registration = lazy;
+  }
+
+  bool lazy_registration() const
+  {
+    return m_lazy_registration;
+  }
+
+  /// Create the argument and return types of all functions added since the last call. Type factories
+  /// may add functions to the module, e.g. for STL containers, and these are processed as well.
+  void materialize_types();
+
+  /// Get the functions with the given name, after creating the Julia types they use. In lazy registration mode, this
+  /// is the point where the types of a function are created, so new box types may be added to the module.
+  std::vector<FunctionWrapperBase*> functions_named(jl_value_t* name);
+
+  /// Get the distinct function names, in the order they were first used. No types are created.
+  const std::vector<jl_value_t*>& function_names();
+
   void bind_constants(ArrayRef<jl_value_t*> symbols, ArrayRef<jl_value_t*> values);
 
   jl_datatype_t* get_julia_type(const char* name)
@@ -779,18 +1088,56 @@ private:
     return lambda_helper(name, std::forward<LambdaT>(lambda), &LambdaT::operator(), std::move(extraData));
   }
 
-  template<typename R, typename LambdaT, typename... ArgsT>
+  template<typename OptionsT = detail::CallOptions<>, typename R, typename LambdaT, typename... ArgsT>
   FunctionWrapperBase& lambda_helper(const std::string& name, LambdaT&& lambda, R(LambdaT::*)(ArgsT...) const, detail::ExtraFunctionData&& extraData)
   {
-    return method_helper(name, std::function<R(ArgsT...)>(std::forward<LambdaT>(lambda)), std::move(extraData));
+    detail::check_noexcept_call<OptionsT, std::decay_t<LambdaT>, ArgsT...>();
+    // Lambdas without captures don't need to be stored, so they are called directly
+    if constexpr (detail::is_stateless_functor_v<std::decay_t<LambdaT>>)
+    {
+      return static_functor_helper<std::decay_t<LambdaT>, R, ArgsT...>(name, std::move(extraData), OptionsT());
+    }
+    else
+    {
+      return method_helper<OptionsT>(name, std::function<R(ArgsT...)>(std::forward<LambdaT>(lambda)), std::move(extraData));
+    }
   }
 
-  template<typename R, typename... Args>
+  template<typename OptionsT = detail::CallOptions<>, typename R, typename... Args>
   FunctionWrapperBase& method_helper(const std::string& name,  std::function<R(Args...)> f, detail::ExtraFunctionData&& extraData)
   {
-    auto* new_wrapper = new FunctionWrapper<R, Args...>(this, f);
+    detail::check_gc_safe_call<OptionsT, R, Args...>();
+    return add_function_wrapper(new FunctionWrapper<R, Args...>(this, f, OptionsT()), name, std::move(extraData));
+  }
+
+  template<typename FunctorT, typename R, typename... Args, typename OptionsT = detail::CallOptions<>>
+  FunctionWrapperBase& static_functor_helper(const std::string& name, detail::ExtraFunctionData&& extraData, OptionsT options = OptionsT())
+  {
+    detail::check_gc_safe_call<OptionsT, R, Args...>();
+    return add_function_wrapper(new StaticFunctionWrapper<FunctorT, R, Args...>(this, options), name, std::move(extraData));
+  }
+
+  template<auto F, typename R, typename... Args, typename... Extra>
+  FunctionWrapperBase& static_method_helper(const std::string& name, R(*)(Args...), Extra... extra)
+  {
+    static_assert(detail::check_extra_argument_count<Extra...>(sizeof...(Args)), "Wrong number of annotated arguments (jlcxx::arg and jlcxx::kwarg arguments)!");
+    using functor_t = detail::StaticFunctor<F, R, Args...>;
+    using options_t = detail::call_options_t<Extra...>;
+    detail::check_noexcept_call<options_t, functor_t, Args...>();
+
+    detail::ExtraFunctionData extraData = detail::parse_attributes<true>(extra...);
+    if(options_t::gc_safe || bool(extraData.force_convert) || detail::NeedConvertHelper<R, Args...>()())
+    {
+      return static_functor_helper<functor_t, R, Args...>(name, std::move(extraData), options_t());
+    }
+
+    return add_function_wrapper(new FunctionPtrWrapper<R, Args...>(this, F), name, std::move(extraData));
+  }
+
+  FunctionWrapperBase& add_function_wrapper(FunctionWrapperBase* new_wrapper, const std::string& name, detail::ExtraFunctionData&& extraData)
+  {
     new_wrapper->set_name((jl_value_t*)jl_symbol(name.c_str()));
-    new_wrapper->set_doc(jl_cstr_to_string(extraData.doc.c_str()));
+    new_wrapper->set_doc(extraData.doc);
     new_wrapper->set_extra_argument_data(std::move(extraData.positionalArguments), std::move(extraData.keywordArguments));
     append_function(new_wrapper);
     return *new_wrapper;
@@ -801,11 +1148,19 @@ private:
 
   jl_module_t* m_jl_mod;
   jl_module_t* m_override_module = nullptr;
-  std::vector<std::shared_ptr<FunctionWrapperBase>> m_functions;
+  std::vector<std::unique_ptr<FunctionWrapperBase>> m_functions;
   std::map<std::string, size_t> m_jl_constants;
   std::vector<std::string> m_constant_names;
   Array<jl_value_t*> m_constant_values;
   std::vector<jl_datatype_t*> m_box_types;
+  bool m_lazy_registration = false;
+  std::size_t m_nb_materialized = 0;
+  // Indices of the functions for each name, keyed on jl_object_id(name) and checked with jl_egal
+  std::map<std::uintptr_t, std::vector<std::size_t>> m_function_index;
+  std::vector<jl_value_t*> m_function_names;
+  std::size_t m_nb_indexed = 0;
+
+  void update_function_index();
 
   template<class T> friend class TypeWrapper;
   template<typename T, typename... AppliedTypesT> friend class ParametricTypeWrappers;
@@ -1025,17 +1380,6 @@ struct ApplyType
   template<typename... Types> using apply = TemplateT<Types...>;
 };
 
-struct SpecializedFinalizer {};
-
-template<typename T, typename Specializer=SpecializedFinalizer>
-struct Finalizer
-{
-  static void finalize(T* to_delete)
-  {
-    delete to_delete;
-  }
-};
-
 namespace detail
 {
   template<typename T>
@@ -1106,7 +1450,20 @@ inline void add_default_methods(Module& mod)
     mod.method("cxxupcast", UpCast<T>::apply);
     DownCast<supertype<T>,T>::apply(mod);
   }
-  if constexpr(std::is_destructible_v<T>)
+  if constexpr(InlineStorage<T>::value)
+  {
+    // Nothing to delete, the object lives in the Julia box
+    mod.method("__delete", [] (T*) {});
+  }
+  else if constexpr(std::is_destructible_v<T> && detail::HasExternalSize<T>::value)
+  {
+    mod.method("__delete", [] (T* to_delete)
+    {
+      detail::unreport_external_size(to_delete);
+      Finalizer<T>::finalize(to_delete);
+    });
+  }
+  else if constexpr(std::is_destructible_v<T>)
   {
     mod.method("__delete", Finalizer<T>::finalize);
   }
@@ -1158,31 +1515,59 @@ public:
     return *this;
   }
 
-  /// Define a member function
+  /// Define a member function. jlcxx::noexcept_call requires a member function declared noexcept
   template<typename R, typename CT, typename... ArgsT, typename... Extra>
   TypeWrapper<T>& method(const std::string& name, R(CT::*f)(ArgsT...), Extra... extra)
   {
+    static_assert(detail::call_options_t<Extra...>::translate_exceptions, "Functions wrapped using jlcxx::noexcept_call must be declared noexcept");
     m_module.method(name, [f](T& obj, ArgsT... args) -> R { return (obj.*f)(args...); }, extra... );
     m_module.method(name, [f](T* obj, ArgsT... args) -> R { return ((*obj).*f)(args...); }, extra... );
     return *this;
   }
 
+  /// Define a member function, noexcept version
+  template<typename R, typename CT, typename... ArgsT, typename... Extra>
+  TypeWrapper<T>& method(const std::string& name, R(CT::*f)(ArgsT...) noexcept, Extra... extra)
+  {
+    m_module.method(name, [f](T& obj, ArgsT... args) noexcept -> R { return (obj.*f)(args...); }, extra... );
+    m_module.method(name, [f](T* obj, ArgsT... args) noexcept -> R { return ((*obj).*f)(args...); }, extra... );
+    return *this;
+  }
+
   /// Define a member function, const version
   template<typename R, typename CT, typename... ArgsT, typename... Extra>
   TypeWrapper<T>& method(const std::string& name, R(CT::*f)(ArgsT...) const, Extra... extra)
   {
+    static_assert(detail::call_options_t<Extra...>::translate_exceptions, "Functions wrapped using jlcxx::noexcept_call must be declared noexcept");
     m_module.method(name, [f](const T& obj, ArgsT... args) -> R { return (obj.*f)(args...); }, extra... );
     m_module.method(name, [f](const T* obj, ArgsT... args) -> R { return ((*obj).*f)(args...); }, extra... );
     return *this;
   }
 
+  /// Define a member function, const noexcept version
+  template<typename R, typename CT, typename... ArgsT, typename... Extra>
+  TypeWrapper<T>& method(const std::string& name, R(CT::*f)(ArgsT...) const noexcept, Extra... extra)
+  {
+    m_module.method(name, [f](const T& obj, ArgsT... args) noexcept -> R { return (obj.*f)(args...); }, extra... );
+    m_module.method(name, [f](const T* obj, ArgsT... args) noexcept -> R { return ((*obj).*f)(args...); }, extra... );
+    return *this;
+  }
+
   /// Define a "member" function using a lambda
   template<typename LambdaT, typename... Extra,
            std::enable_if_t<detail::has_call_operator<LambdaT>::value && !std::is_member_function_pointer_v<LambdaT>, bool> = true>
   TypeWrapper<T>& method(const std::string& name, LambdaT&& lambda, Extra... extra)
   {
     detail::ExtraFunctionData extraData = detail::parse_attributes(extra...);
-    m_module.lambda_helper(name, std::forward<LambdaT>(lambda), &LambdaT::operator(), std::move(extraData));
+    m_module.template lambda_helper<detail::call_options_t<Extra...>>(name, std::forward<LambdaT>(lambda), &LambdaT::operator(), std::move(extraData));
+    return *this;
+  }
+
+  /// Define a member function that is known at compile time, e.g. method<&Foo::bar>("bar"). The call bypasses std::function
+  template<auto F, typename... Extra>
+  TypeWrapper<T>& method(const std::string& name, Extra... extra)
+  {
+    static_method_helper<F>(name, F, extra...);
     return *this;
   }
 
@@ -1224,6 +1609,7 @@ public:
   TypeWrapper<T>& apply(FunctorT&& apply_ftor)
   {
     static_assert(detail::IsParametric<T>::value, "Apply can only be called on parametric types");
+    profiling::Scope profile_scope("apply", [this] { return julia_type_name(m_dt); });
     apply<AppliedTypesT...>().apply(std::forward<FunctorT>(apply_ftor));
     return *this;
   }
@@ -1248,6 +1634,35 @@ public:
 
 private:
 
+  template<auto F, typename R, typename CT, typename... ArgsT, typename... Extra>
+  void static_method_helper(const std::string& name, R(CT::*)(ArgsT...), Extra... extra)
+  {
+    static_member_helper<F, R, T&, ArgsT...>(name, extra...);
+    static_member_helper<F, R, T*, ArgsT...>(name, extra...);
+  }
+
+  template<auto F, typename R, typename CT, typename... ArgsT, typename... Extra>
+  void static_method_helper(const std::string& name, R(CT::*)(ArgsT...) const, Extra... extra)
+  {
+    static_member_helper<F, R, const T&, ArgsT...>(name, extra...);
+    static_member_helper<F, R, const T*, ArgsT...>(name, extra...);
+  }
+
+  template<auto F, typename R, typename ObjT, typename... ArgsT, typename... Extra>
+  void static_member_helper(const std::string& name, Extra... extra)
+  {
+    using functor_t = detail::StaticFunctor<F, R, ObjT, ArgsT...>;
+    using options_t = detail::call_options_t<Extra...>;
+    detail::check_noexcept_call<options_t, functor_t, ObjT, ArgsT...>();
+    m_module.template static_functor_helper<functor_t, R, ObjT, ArgsT...>(name, detail::parse_attributes(extra...), options_t());
+  }
+
+  template<auto F, typename R, typename... ArgsT, typename... Extra>
+  void static_method_helper(const std::string& name, R(*)(ArgsT...), Extra... extra)
+  {
+    m_module.template method<F>(name, extra...);
+  }
+
   Module& m_module;
   jl_datatype_t* m_dt;
   jl_datatype_t* m_box_dt;
@@ -1284,6 +1699,7 @@ TypeWrapper<T> Module::add_type_internal(const std::string& name, JLSuperT* supe
   static_assert(!IsMirroredType<T>::value, "Mirrored types (marked with IsMirroredType) can't be added using add_type, map them directly to a struct instead and use map_type or explicitly disable mirroring for this type, e.g. define template<> struct IsMirroredType<Foo> : std::false_type { };");
   static_assert(!std::is_scalar_v<T>, "Scalar types must be added using add_bits");
 
+  profiling::Scope profile_scope("add_type", name);
   if(get_constant(name) != nullptr)
   {
     throw std::runtime_error("Duplicate registration of type or constant " + name);
@@ -1298,8 +1714,21 @@ TypeWrapper<T> Module::add_type_internal(const std::string& name, JLSuperT* supe
   JL_GC_PUSH5(&super, &parameters, &super_parameters, &fnames, &ftypes);
 
   parameters = is_parametric ? parameter_list<T>()() : jl_emptysvec;
-  fnames = jl_svec1(jl_symbol("cpp_object"));
-  ftypes = jl_svec1(jl_voidpointer_type);
+  if constexpr(InlineStorage<T>::value)
+  {
+    static_assert(!is_parametric && detail::check_inline_storage<T>(), "InlineStorage is not supported for parametric types");
+    // cpp_storage::NTuple{N,UInt64}, placed after the pointer at the offset chosen by Julia for its alignment
+    fnames = jl_svec2(jl_symbol("cpp_object"), jl_symbol("cpp_storage"));
+    jl_value_t* storage_params[2] = {jl_box_long(detail::inline_storage_words<T>), (jl_value_t*)julia_type<uint64_t>()};
+    JL_GC_PUSH1(&storage_params[0]);
+    ftypes = jl_svec2(jl_voidpointer_type, apply_type(julia_type("NTuple", jl_core_module), storage_params, 2));
+    JL_GC_POP();
+  }
+  else
+  {
+    fnames = jl_svec1(jl_symbol("cpp_object"));
+    ftypes = jl_svec1(jl_voidpointer_type);
+  }
 
   if(jl_is_datatype(super_generic) && !jl_is_unionall(super_generic) && !(is_parametric && SuperParametersT::nb_parameters != 0))
   {
@@ -1325,12 +1754,12 @@ TypeWrapper<T> Module::add_type_internal(const std::string& name, JLSuperT* supe
 
   // Create the datatypes
   jl_datatype_t* base_dt = new_datatype(jl_symbol(name.c_str()), m_jl_mod, super, parameters, jl_emptysvec, jl_emptysvec, 1, 0, 0);
-  protect_from_gc(base_dt);
+  protect_from_gc_permanent(base_dt);
 
   super = is_parametric ? (jl_datatype_t*)apply_type((jl_value_t*)base_dt, parameters) : base_dt;
 
   jl_datatype_t* box_dt = new_datatype(jl_symbol(allocname.c_str()), m_jl_mod, super, parameters, fnames, ftypes, 0, 1, 1);
-  protect_from_gc(box_dt);
+  protect_from_gc_permanent(box_dt);
 
   // Register the type
   if(is_parametric)
@@ -1488,7 +1917,7 @@ void Module::add_bits(const std::string& name, JLSuperT* super)
   jl_svec_t* params = is_parametric ? parameter_list<T>()() : jl_emptysvec;
   JL_GC_PUSH1(&params);
   jl_datatype_t* dt = new_bitstype(jl_symbol(name.c_str()), m_jl_mod, (jl_datatype_t*)super, params, 8*sizeof(T));
-  protect_from_gc(dt);
+  protect_from_gc_permanent(dt);
   JL_GC_POP();
   detail::dispatch_set_julia_type<T, is_parametric>()(dt);
   set_const(name, (jl_value_t*)dt);
@@ -1520,6 +1949,7 @@ public:
   bool has_current_module() { return m_current_module != nullptr; }
   Module& current_module();
   void reset_current_module() { m_current_module = nullptr; }
+  void set_current_module(Module* mod) { m_current_module = mod; }
 
 private:
   std::map<jl_module_t*, std::shared_ptr<Module>> m_modules;
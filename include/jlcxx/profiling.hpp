@@ -0,0 +1,103 @@
+#ifndef JLCXX_PROFILING_HPP
+#define JLCXX_PROFILING_HPP
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+
+#include "jlcxx_config.hpp"
+
+// Opt-in measurement of the time spent registering modules. Enable it by setting the environment variable
+// JLCXX_PROFILE_REGISTRATION to the path of a CSV file (or "-" for stderr), or through enable_registration_profiling.
+
+namespace jlcxx
+{
+
+namespace profiling
+{
+
+/// Set from JLCXX_PROFILE_REGISTRATION when the library is loaded, or through set_enabled
+extern JLCXX_API std::atomic<bool> g_enabled;
+
+/// True if registration profiling is active. Inline, since every Scope checks it
+inline bool enabled()
+{
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+/// Turn registration profiling on or off
+JLCXX_API void set_enabled(bool enable);
+
+/// Attribute the following measurements to the given module, until end_module is called
+JLCXX_API void begin_module(const std::string& module_name);
+
+/// Finish a registration phase for the current module, writing its measurements to the output file if one was set
+JLCXX_API void end_module();
+
+/// All measurements so far as CSV, with columns module,category,name,calls,total_ns,self_ns,julia_bytes
+JLCXX_API std::string report_csv();
+
+/// Attributes measurements to a module during its lifetime, i.e. calls begin_module and end_module
+class ModuleScope
+{
+public:
+  ModuleScope(const std::string& module_name)
+  {
+    begin_module(module_name);
+  }
+
+  ~ModuleScope()
+  {
+    end_module();
+  }
+
+  ModuleScope(const ModuleScope&) = delete;
+  ModuleScope& operator=(const ModuleScope&) = delete;
+};
+
+/// Measures the wall time and Julia allocations during its lifetime, if profiling is enabled.
+/// Nested scopes are included in the total time of the enclosing scope, but not in its self time.
+class Scope
+{
+public:
+  Scope(const char* category, const std::string& name) : m_active(enabled())
+  {
+    if(m_active)
+    {
+      start(category, name);
+    }
+  }
+
+  /// Use a callable for names that are expensive to build, so the cost is only paid when profiling
+  template<typename NameF, typename = std::enable_if_t<std::is_invocable_r_v<std::string, NameF>>>
+  Scope(const char* category, NameF&& name_f) : m_active(enabled())
+  {
+    if(m_active)
+    {
+      start(category, name_f());
+    }
+  }
+
+  ~Scope()
+  {
+    if(m_active)
+    {
+      stop();
+    }
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  JLCXX_API static void start(const char* category, const std::string& name);
+  JLCXX_API static void stop();
+
+  bool m_active;
+};
+
+}
+
+}
+
+#endif
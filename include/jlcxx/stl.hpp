@@ -1,6 +1,16 @@
 #ifndef JLCXX_STL_HPP
 #define JLCXX_STL_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <thread>
 #include <type_traits>
 #include <valarray>
 #include <vector>
@@ -11,6 +21,8 @@
 #include <unordered_set>
 #include <list>
 #include <forward_list>
+#include <map>
+#include <unordered_map>
 
 #include "module.hpp"
 #include "smart_pointers.hpp"
@@ -20,6 +32,10 @@
 #include <ranges>
 #endif
 
+#ifdef JLCXX_USE_EXECUTION_POLICY
+#include <execution>
+#endif
+
 namespace jlcxx
 {
 
@@ -107,6 +123,16 @@ struct uses_std_allocator<C, std::void_t<typename C::allocator_type>>
 
 template <typename C>
 inline constexpr bool uses_std_allocator_v = uses_std_allocator<C>::value;
+
+// === has_reserve ===
+template <typename C, typename = void>
+struct has_reserve : std::false_type {};
+
+template <typename C>
+struct has_reserve<C, std::void_t<decltype(std::declval<C&>().reserve(std::size_t(0)))>> : std::true_type {};
+
+template <typename C>
+inline constexpr bool has_reserve_v = has_reserve<C>::value;
 }
 
 namespace stl
@@ -114,10 +140,40 @@ namespace stl
 
 JLCXX_API jl_module_t* stl_module();
 
+/// True if the StdLib container and element type combinations are only recorded when CxxWrap loads, and each is wrapped
+/// when it is first used. Off by default, or set with JLCXX_LAZY_STL=1. This is separate from lazy registration of the
+/// functions, since the Julia side must call instantiate_stl_type for deferred types. Set it before the StdLib module is
+/// registered.
+JLCXX_API void set_lazy_stl(bool lazy);
+JLCXX_API bool lazy_stl();
+
+/// The parametric isbits type ChunkCursor{C} of the StdLib module, see wrap_chunked_iteration
+JLCXX_API jl_value_t* chunk_cursor_type();
+
 JLCXX_API  void set_wrapper(Module& stl, std::string name, jl_value_t* supertype);
 JLCXX_API  TypeWrapper1& get_wrapper(std::string name);
 JLCXX_API  bool has_wrapper(std::string name);
 
+using TypeWrapper2 = TypeWrapper<Parametric<TypeVar<1>, TypeVar<2>>>;
+
+/// Same as set_wrapper and friends, for types with a key and a value parameter
+JLCXX_API  void set_map_wrapper(Module& stl, std::string name, jl_value_t* supertype);
+JLCXX_API  TypeWrapper2& get_map_wrapper(std::string name);
+JLCXX_API  bool has_map_wrapper(std::string name);
+
+/// Record how to wrap the STL type with the given name (e.g. StdVector) and Julia type parameters, for lazy registration
+JLCXX_API  void add_deferred_type(const std::string& name, std::vector<jl_value_t*> parameters, void(*instantiate)());
+
+/// Set the number of threads used by the parallel algorithms (StdSort, StdReduce, ...). 0, the default, means
+/// std::thread::hardware_concurrency(), or the standard library execution policy if JLCXX_USE_EXECUTION_POLICY is defined.
+JLCXX_API void set_algorithm_threads(std::size_t n);
+JLCXX_API std::size_t algorithm_threads();
+
+/// Call task(i) for i in [0, nb_tasks): task 0 on the calling thread and the others on a pool of worker threads
+/// that persists between calls. Returns when all tasks are done. task must not throw.
+/// If the tasks can't be handed to the pool, e.g. because no worker thread can be started, this throws before running any.
+JLCXX_API void run_parallel_tasks(std::size_t nb_tasks, const std::function<void(std::size_t)>& task);
+
 // Separate per-container functions to split up the compilation over multiple C++ files
 void apply_vector();
 void apply_valarray();
@@ -131,6 +187,9 @@ void apply_unordered_set();
 void apply_unordered_multiset();
 void apply_list();
 void apply_forward_list();
+void apply_map();
+void apply_unordered_map();
+void apply_multimap();
 void apply_shared_ptr();
 void apply_weak_ptr();
 void apply_unique_ptr();
@@ -148,7 +207,6 @@ using stltypes = remove_duplicates<combine_parameterlists<combine_parameterlists
   jl_value_t*
 >, fundamental_int_types>, fixed_int_types>>;
 
-
 template<typename T>
 struct ReferenceTypes
 {
@@ -191,6 +249,267 @@ template<typename T>
 using reftype = typename ReferenceTypes<T>::reference;
 
 
+/// True if ArrayRef<T> stores its elements as T, so they can be copied from and to its data in one go.
+/// Julia object pointers are excluded, since storing them in an array needs a write barrier.
+template<typename T>
+constexpr bool is_direct_arrayref_v = std::is_same_v<typename ArrayRef<T>::julia_t, T> && !jlcxx::detail::is_julia_pointer_v<T>;
+
+/// Copy the elements of arr to out, directly from the array data if possible
+template<typename T, typename OutputIteratorT>
+OutputIteratorT copy_from_array(ArrayRef<T> arr, OutputIteratorT out)
+{
+  if constexpr(is_direct_arrayref_v<T>)
+  {
+    return std::copy(arr.data(), arr.data() + arr.size(), out);
+  }
+  else
+  {
+    return std::copy(arr.begin(), arr.end(), out);
+  }
+}
+
+/// Append the elements of arr to a vector or deque, using a single range insert if the array stores T directly.
+/// For trivially copyable T this ends up as a memmove.
+template<typename WrappedT, typename T>
+void append_array(WrappedT& v, ArrayRef<T> arr)
+{
+  if constexpr(is_direct_arrayref_v<T>)
+  {
+    v.insert(v.end(), arr.data(), arr.data() + arr.size());
+  }
+  else
+  {
+    for(std::size_t i = 0; i != arr.size(); ++i)
+    {
+      v.push_back(arr[i]);
+    }
+  }
+}
+
+/// Copy all elements of a container to the start of dest, like Base.copyto!
+template<typename WrappedT, typename T>
+ArrayRef<T> copy_to_array(ArrayRef<T> dest, const WrappedT& v)
+{
+  static_assert(is_direct_arrayref_v<T>, "Elements can only be copied into the array data if it stores T directly and needs no write barrier");
+  if(dest.size() < std::size(v))
+  {
+    throw std::runtime_error("Destination array of length " + std::to_string(dest.size()) + " is too short for " + std::to_string(std::size(v)) + " elements");
+  }
+  std::copy(std::begin(v), std::end(v), dest.data());
+  return dest;
+}
+
+/// Throw if the n elements starting at the 1-based index first are not all in a container of length size
+inline void check_index_range(const std::size_t size, const cxxint_t first, const std::size_t n)
+{
+  if(first < 1 || std::size_t(first - 1) > size || n > size - std::size_t(first - 1))
+  {
+    throw std::runtime_error("Range of " + std::to_string(n) + " elements starting at index " + std::to_string(first) + " is out of bounds for a container of length " + std::to_string(size));
+  }
+}
+
+inline void check_indices_length(const std::size_t nb_values, const std::size_t nb_indices)
+{
+  if(nb_values != nb_indices)
+  {
+    throw std::runtime_error("Got " + std::to_string(nb_values) + " values for " + std::to_string(nb_indices) + " indices");
+  }
+}
+
+/// Check that found is a Julia Vector{Bool} of the given length and return its data. ArrayRef<bool> would require a
+/// Vector{CxxBool}, so the bulk lookups take their boolean output as an untyped array. Vector{CxxBool} is also accepted.
+inline bool* bool_array_data(jl_value_t* found, const std::size_t length)
+{
+  if(!jl_is_array(found) || (jl_array_eltype(found) != (jl_value_t*)jl_bool_type && jl_array_eltype(found) != (jl_value_t*)julia_type<bool>()))
+  {
+    throw std::runtime_error("Expected an Array{Bool} for the boolean output");
+  }
+  static_assert(sizeof(bool) == 1, "Julia Bool arrays store one byte per element");
+  check_indices_length(jl_array_len((jl_array_t*)found), length);
+  return jlcxx_array_data<bool>((jl_array_t*)found);
+}
+
+/// Add batch element access to a random access container whose elements can be stored directly in a Julia array,
+/// so a whole range or list of indices is read or written in a single call:
+/// - cxxgetrange!(v, dest, first) and cxxsetrange!(v, src, first) copy length(dest) or length(src) elements starting at first
+/// - cxxgetindices!(v, dest, indices) and cxxsetindices!(v, src, indices) access the elements at the given indices
+template<typename TypeWrapperT>
+void wrap_batch_access(TypeWrapperT& wrapped)
+{
+  using WrappedT = typename TypeWrapperT::type;
+  using T = typename WrappedT::value_type;
+  if constexpr(is_direct_arrayref_v<T>)
+  {
+    wrapped.method("cxxgetrange!", [] (const WrappedT& v, ArrayRef<T> dest, const cxxint_t first)
+    {
+      check_index_range(std::size(v), first, dest.size());
+      std::copy_n(std::begin(v) + (first - 1), dest.size(), dest.data());
+    });
+    wrapped.method("cxxsetrange!", [] (WrappedT& v, ArrayRef<T> src, const cxxint_t first)
+    {
+      check_index_range(std::size(v), first, src.size());
+      std::copy_n(src.data(), src.size(), std::begin(v) + (first - 1));
+    });
+    wrapped.method("cxxgetindices!", [] (const WrappedT& v, ArrayRef<T> dest, ArrayRef<cxxint_t> indices)
+    {
+      check_indices_length(dest.size(), indices.size());
+      const std::size_t size = std::size(v);
+      T* out = dest.data();
+      const cxxint_t* idx = indices.data();
+      for(std::size_t i = 0; i != indices.size(); ++i)
+      {
+        check_index_range(size, idx[i], 1);
+        out[i] = v[idx[i] - 1];
+      }
+    });
+    wrapped.method("cxxsetindices!", [] (WrappedT& v, ArrayRef<T> src, ArrayRef<cxxint_t> indices)
+    {
+      check_indices_length(src.size(), indices.size());
+      const std::size_t size = std::size(v);
+      const T* in = src.data();
+      const cxxint_t* idx = indices.data();
+      for(std::size_t i = 0; i != indices.size(); ++i)
+      {
+        check_index_range(size, idx[i], 1);
+        v[idx[i] - 1] = in[i];
+      }
+    });
+  }
+}
+
+namespace detail
+{
+  /// Position of a chunked iteration over a ContainerT, mirrored in Julia as the isbits type StdLib.ChunkCursor{C}, with
+  /// C the Julia type of the container, so a cursor can't be passed to chunk_next! for another container type.
+  /// It holds the bits of a container iterator, so only containers with trivially copyable iterators that fit in 64
+  /// bits can be iterated in chunks: the node pointer of list, set and unordered_set iterators on common standard
+  /// libraries, but e.g. not the checked iterators of debug builds.
+  template<typename ContainerT>
+  struct ChunkCursor
+  {
+    using iterator_type = typename ContainerT::const_iterator;
+    static constexpr bool is_supported = std::is_trivially_copyable_v<iterator_type> && sizeof(iterator_type) <= sizeof(std::uint64_t);
+
+    static ChunkCursor encode(const iterator_type it)
+    {
+      ChunkCursor result{0};
+      std::memcpy(&result.position, &it, sizeof(iterator_type));
+      return result;
+    }
+
+    iterator_type decode() const
+    {
+      iterator_type result;
+      std::memcpy(static_cast<void*>(&result), &position, sizeof(iterator_type));
+      return result;
+    }
+
+    std::uint64_t position;
+  };
+}
+
+/// Add chunked iteration to a node-based container, avoiding the boxed iterator objects of iteratorbegin and iterator_next:
+/// - chunk_cursor(v) returns a cursor to the first element, of the isbits type StdLib.ChunkCursor{typeof(v)}
+/// - chunk_next!(v, dest, cursor) copies up to length(dest) elements starting at cursor into dest, advances cursor
+///   past them and returns the number of copied elements. Iteration is finished when this is less than length(dest).
+/// The cursor is an iterator and is not checked: like a C++ iterator it must only be used with the container it came
+/// from, and it is invalidated by erasing the element it points to, clearing, swapping, moving or destroying the
+/// container, and for unordered containers by any insertion that rehashes.
+/// Containers with iterators that don't fit in a ChunkCursor don't get these methods.
+template<typename TypeWrapperT>
+void wrap_chunked_iteration(TypeWrapperT& wrapped)
+{
+  using WrappedT = typename TypeWrapperT::type;
+  using T = typename WrappedT::value_type;
+  using CursorT = detail::ChunkCursor<WrappedT>;
+  if constexpr(is_direct_arrayref_v<T> && CursorT::is_supported)
+  {
+    if(!has_julia_type<CursorT>())
+    {
+      set_julia_type<CursorT>(apply_type(chunk_cursor_type(), julia_base_type<WrappedT>()));
+    }
+    wrapped.module().set_override_module(stl_module());
+    wrapped.method("chunk_cursor", [] (const WrappedT& v) { return CursorT::encode(v.begin()); });
+    wrapped.method("chunk_next!", [] (const WrappedT& v, ArrayRef<T> dest, CursorT& cursor)
+    {
+      auto it = cursor.decode();
+      const auto end = v.end();
+      T* out = dest.data();
+      std::size_t n = 0;
+      for(; n != dest.size() && it != end; ++n, ++it)
+      {
+        out[n] = *it;
+      }
+      cursor = CursorT::encode(it);
+      return cxxint_t(n);
+    });
+    wrapped.module().unset_override_module();
+  }
+}
+
+/// Add whole-array variants of the set methods, named with the given prefix ("set_" or "multiset_"):
+/// - insert_all!(v, keys) and delete_all!(v, keys) insert or erase every element of keys
+/// - in!(dest, v, keys) sets dest[i] to whether keys[i] is in v and returns dest, a Vector{Bool}
+/// - count!(dest, v, keys) sets dest[i] to the number of occurrences of keys[i] and returns dest
+/// Unordered sets also get reserve! and rehash!, and reserve room for all keys before a bulk insert.
+template<typename TypeWrapperT>
+void wrap_set_bulk(TypeWrapperT& wrapped, const std::string& prefix)
+{
+  using WrappedT = typename TypeWrapperT::type;
+  using T = typename WrappedT::value_type;
+  constexpr bool is_unordered = jlcxx::detail::has_reserve_v<WrappedT>;
+
+  wrapped.method(prefix + "insert_all!", [] (WrappedT& v, ArrayRef<T> keys)
+  {
+    if constexpr(is_unordered)
+    {
+      v.reserve(v.size() + keys.size());
+    }
+    if constexpr(is_direct_arrayref_v<T>)
+    {
+      v.insert(keys.data(), keys.data() + keys.size());
+    }
+    else
+    {
+      for(std::size_t i = 0; i != keys.size(); ++i)
+      {
+        v.insert(keys[i]);
+      }
+    }
+  });
+  wrapped.method(prefix + "delete_all!", [] (WrappedT& v, ArrayRef<T> keys)
+  {
+    for(std::size_t i = 0; i != keys.size(); ++i)
+    {
+      v.erase(keys[i]);
+    }
+  });
+  wrapped.method(prefix + "in!", [] (jl_value_t* dest, const WrappedT& v, ArrayRef<T> keys)
+  {
+    bool* out = bool_array_data(dest, keys.size());
+    for(std::size_t i = 0; i != keys.size(); ++i)
+    {
+      out[i] = v.find(keys[i]) != v.end();
+    }
+    return dest;
+  });
+  wrapped.method(prefix + "count!", [] (ArrayRef<cxxint_t> dest, const WrappedT& v, ArrayRef<T> keys)
+  {
+    check_indices_length(dest.size(), keys.size());
+    cxxint_t* out = dest.data();
+    for(std::size_t i = 0; i != keys.size(); ++i)
+    {
+      out[i] = cxxint_t(v.count(keys[i]));
+    }
+    return dest;
+  });
+  if constexpr(is_unordered)
+  {
+    wrapped.method(prefix + "reserve!", [] (WrappedT& v, const cxxint_t n) { v.reserve(n); });
+    wrapped.method(prefix + "rehash!", [] (WrappedT& v, const cxxint_t n) { v.rehash(n); });
+  }
+}
+
 template<typename TypeWrapperT>
 void wrap_range_based_fill([[maybe_unused]] TypeWrapperT& wrapped)
 {
@@ -225,6 +544,229 @@ void wrap_range_based_bsearch([[maybe_unused]] TypeWrapperT& wrapped)
 #endif
 }
 
+namespace detail
+{
+  template<typename T, typename = void>
+  struct is_less_comparable : std::false_type {};
+
+  template<typename T>
+  struct is_less_comparable<T, std::void_t<decltype(std::declval<const T&>() < std::declval<const T&>())>> : std::true_type {};
+
+  /// Element types that the parallel algorithms sort. Pointers only compare by address, and vector<bool> has proxy iterators.
+  template<typename T>
+  constexpr bool is_sortable_v = is_less_comparable<T>::value && !std::is_pointer_v<T> && !std::is_same_v<T, bool>;
+
+  template<typename T>
+  constexpr bool is_summable_v = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+  /// Type used to accumulate sums of T, so sums of small integers don't overflow at the width of the element type
+  template<typename T>
+  using sum_type_t = std::conditional_t<std::is_integral_v<T> && (sizeof(T) < sizeof(int64_t)),
+    std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>, T>;
+
+  /// Only sorts of arithmetic types can run GC-safe and on worker threads: a user-defined operator< may call back into Julia
+  template<typename T>
+  constexpr bool is_gc_safe_sortable_v = std::is_arithmetic_v<T>;
+
+  /// Below this number of elements the algorithms run on the calling thread only
+  constexpr std::size_t parallel_grain_size = 1 << 15;
+
+  /// Number of chunks to split n elements into, at most one per thread and each at least parallel_grain_size long
+  inline std::size_t nb_parallel_chunks(const std::size_t n)
+  {
+    const std::size_t nb_threads = algorithm_threads() == 0 ? std::thread::hardware_concurrency() : algorithm_threads();
+    return std::max(std::size_t(1), std::min(nb_threads, n / parallel_grain_size));
+  }
+
+  /// Call f(chunk, first, last) for each of nb_chunks consecutive index ranges that split [0, n), in parallel on the
+  /// algorithm thread pool. A single chunk runs directly on the calling thread.
+  /// The first exception thrown by any chunk is rethrown after all chunks are done.
+  template<typename FunctorT>
+  void parallel_chunks(const std::size_t n, const std::size_t nb_chunks, FunctorT&& f)
+  {
+    if(nb_chunks == 1)
+    {
+      f(std::size_t(0), std::size_t(0), n);
+      return;
+    }
+    std::vector<std::exception_ptr> errors(nb_chunks);
+    run_parallel_tasks(nb_chunks, [&] (const std::size_t chunk)
+    {
+      try
+      {
+        f(chunk, n * chunk / nb_chunks, n * (chunk + 1) / nb_chunks);
+      }
+      catch(...)
+      {
+        errors[chunk] = std::current_exception();
+      }
+    });
+    for(const std::exception_ptr& e : errors)
+    {
+      if(e)
+      {
+        std::rethrow_exception(e);
+      }
+    }
+  }
+
+  /// Sort chunks in parallel, then merge neighbouring sorted runs pairwise, doubling the run length each round.
+  /// std::inplace_merge is stable, so this is a stable sort if the chunks are sorted using std::stable_sort.
+  template<bool Stable, typename IteratorT>
+  void parallel_sort(IteratorT first, IteratorT last)
+  {
+    const std::size_t n = std::distance(first, last);
+    const std::size_t nb_chunks = nb_parallel_chunks(n);
+    if(nb_chunks == 1)
+    {
+      if constexpr(Stable)
+      {
+        std::stable_sort(first, last);
+      }
+      else
+      {
+        std::sort(first, last);
+      }
+      return;
+    }
+#ifdef JLCXX_USE_EXECUTION_POLICY
+    if(algorithm_threads() == 0)
+    {
+      if constexpr(Stable)
+      {
+        std::stable_sort(std::execution::par, first, last);
+      }
+      else
+      {
+        std::sort(std::execution::par, first, last);
+      }
+      return;
+    }
+#endif
+    std::vector<std::size_t> bounds(nb_chunks + 1);
+    for(std::size_t chunk = 0; chunk <= nb_chunks; ++chunk)
+    {
+      bounds[chunk] = n * chunk / nb_chunks;
+    }
+    parallel_chunks(n, nb_chunks, [first] (std::size_t, const std::size_t b, const std::size_t e)
+    {
+      if constexpr(Stable)
+      {
+        std::stable_sort(first + b, first + e);
+      }
+      else
+      {
+        std::sort(first + b, first + e);
+      }
+    });
+    for(std::size_t width = 1; width < nb_chunks; width *= 2)
+    {
+      const std::size_t nb_merges = (nb_chunks + 2*width - 1) / (2*width);
+      parallel_chunks(nb_merges, nb_merges, [&, first] (const std::size_t merge, std::size_t, std::size_t)
+      {
+        const std::size_t lo = merge * 2 * width;
+        const std::size_t mid = std::min(lo + width, nb_chunks);
+        const std::size_t hi = std::min(lo + 2 * width, nb_chunks);
+        std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi]);
+      });
+    }
+  }
+
+  /// Sum of f(i) over [0, n), with partial sums per chunk. For floating point types the result can differ in the last
+  /// bits from a serial sum, and it depends on the number of threads.
+  template<typename T, typename FunctorT>
+  T parallel_sum(const std::size_t n, FunctorT&& f)
+  {
+    const std::size_t nb_chunks = nb_parallel_chunks(n);
+    std::vector<T> partial_sums(nb_chunks, T(0));
+    parallel_chunks(n, nb_chunks, [&] (const std::size_t chunk, const std::size_t b, const std::size_t e)
+    {
+      T sum(0);
+      for(std::size_t i = b; i != e; ++i)
+      {
+        sum += f(i);
+      }
+      partial_sums[chunk] = sum;
+    });
+    return std::accumulate(partial_sums.begin(), partial_sums.end(), T(0));
+  }
+}
+
+/// Add algorithms that split their work over algorithm_threads() threads to a random access container:
+/// - StdSort(v) and StdStableSort(v) sort v in place
+/// - StdUnique(v) removes consecutive duplicates and returns the new length
+/// - StdReduce(v) returns the sum of the elements
+/// - StdTransformReduce(v, w) returns the sum of v[i]*w[i]
+/// Sums of integers narrower than 64 bits are accumulated and returned as 64-bit integers.
+/// The long-running functions are gc_safe, so other Julia threads can collect garbage while they run. Sorts only run
+/// in parallel and gc_safe for arithmetic element types, since comparing other types may call back into Julia.
+template<typename TypeWrapperT>
+void wrap_parallel_algorithms(TypeWrapperT& wrapped)
+{
+  using WrappedT = typename TypeWrapperT::type;
+  using T = typename WrappedT::value_type;
+  if constexpr(detail::is_sortable_v<T>)
+  {
+    if constexpr(detail::is_gc_safe_sortable_v<T>)
+    {
+      wrapped.method("StdSort", [] (WrappedT& v) { detail::parallel_sort<false>(std::begin(v), std::end(v)); }, gc_safe);
+      wrapped.method("StdStableSort", [] (WrappedT& v) { detail::parallel_sort<true>(std::begin(v), std::end(v)); }, gc_safe);
+    }
+    else
+    {
+      // Comparisons may call into Julia, which the worker threads can't do, so these sort on the calling thread
+      wrapped.method("StdSort", [] (WrappedT& v) { std::sort(std::begin(v), std::end(v)); });
+      wrapped.method("StdStableSort", [] (WrappedT& v) { std::stable_sort(std::begin(v), std::end(v)); });
+    }
+    wrapped.method("StdUnique", [] (WrappedT& v)
+    {
+      auto last = std::unique(std::begin(v), std::end(v));
+      const std::size_t n = std::distance(std::begin(v), last);
+      if constexpr(std::is_same_v<WrappedT, std::valarray<T>>)
+      {
+        v = WrappedT(std::begin(v), n);
+      }
+      else
+      {
+        v.erase(last, v.end());
+      }
+      return cxxint_t(n);
+    });
+  }
+  if constexpr(detail::is_summable_v<T>)
+  {
+    using SumT = detail::sum_type_t<T>;
+    wrapped.method("StdReduce", [] (const WrappedT& v)
+    {
+      auto first = std::begin(v);
+#ifdef JLCXX_USE_EXECUTION_POLICY
+      if(algorithm_threads() == 0 && detail::nb_parallel_chunks(std::size(v)) != 1)
+      {
+        return std::reduce(std::execution::par, first, std::end(v), SumT(0));
+      }
+#endif
+      return detail::parallel_sum<SumT>(std::size(v), [first] (const std::size_t i) { return SumT(first[i]); });
+    }, gc_safe);
+    wrapped.method("StdTransformReduce", [] (const WrappedT& v, const WrappedT& w)
+    {
+      if(std::size(v) != std::size(w))
+      {
+        throw std::runtime_error("Containers of length " + std::to_string(std::size(v)) + " and " + std::to_string(std::size(w)) + " have different lengths");
+      }
+      auto vfirst = std::begin(v);
+      auto wfirst = std::begin(w);
+#ifdef JLCXX_USE_EXECUTION_POLICY
+      if(algorithm_threads() == 0 && detail::nb_parallel_chunks(std::size(v)) != 1)
+      {
+        return std::transform_reduce(std::execution::par, vfirst, std::end(v), wfirst, SumT(0), std::plus<SumT>(),
+          [] (const T& a, const T& b) { return SumT(a) * SumT(b); });
+      }
+#endif
+      return detail::parallel_sum<SumT>(std::size(v), [vfirst, wfirst] (const std::size_t i) { return SumT(vfirst[i]) * SumT(wfirst[i]); });
+    }, gc_safe);
+  }
+}
+
 
 template <typename ValueT, template<typename...> typename ContainerT>
 struct IteratorWrapper
@@ -246,6 +788,20 @@ struct WrapIterator
     wrapped.method("iterator_next", [](WrappedT it) { ++(it.value); return it; });
     wrapped.method("iterator_value", [](WrappedT it) { return *it.value; });
     wrapped.method("iterator_is_equal", [](WrappedT it1, WrappedT it2) {return it1.value == it2.value; });
+    if constexpr(is_direct_arrayref_v<ValueT>)
+    {
+      // Copy up to length(dest) elements, stopping at end, and advance it past them. Returns the number of copied elements.
+      wrapped.method("iterator_copy_n!", [](WrappedT& it, WrappedT end, ArrayRef<ValueT> dest)
+      {
+        ValueT* out = dest.data();
+        std::size_t n = 0;
+        for(; n != dest.size() && it.value != end.value; ++n, ++it.value)
+        {
+          out[n] = *it.value;
+        }
+        return cxxint_t(n);
+      });
+    }
   };
 };
 
@@ -331,6 +887,16 @@ struct STLTypeWrapperBase
     detail::ApplyCombination<T>::template apply<TypeLists...>(typewrapper(), *static_cast<T*>(this));
   }
 
+  /// Create the generic Julia types without applying them to any parameters
+  void declare_types()
+  {
+    typewrapper();
+    if constexpr (has_iterator)
+    {
+      iteratorwrapper();
+    }
+  }
+
   template<typename AppliedT>
   void apply(Module& module)
   {
@@ -419,21 +985,242 @@ struct WrapSTLContainer<std::vector> : STLTypeWrapperBase<WrapSTLContainer<std::
     // we can simply fall back to the slower non-reserved method.
     wrapped.method("append", [] (WrappedT& v, jlcxx::ArrayRef<T> arr)
     {
-      const std::size_t addedlen = arr.size();
       if constexpr(jlcxx::detail::is_move_insertable_v<T, typename WrappedT::allocator_type>)
       {
-        v.reserve(v.size() + addedlen);
+        v.reserve(v.size() + arr.size());
       }
-      for(size_t i = 0; i != addedlen; ++i)
-        {
-          v.push_back(arr[i]);
-        }
+      append_array(v, arr);
     });
+    if constexpr(is_direct_arrayref_v<T>)
+    {
+      wrapped.method("assign", [] (WrappedT& v, jlcxx::ArrayRef<T> arr) { v.assign(arr.data(), arr.data() + arr.size()); });
+      wrapped.method("cxxcopyto!", [] (jlcxx::ArrayRef<T> dest, const WrappedT& v) { return copy_to_array(dest, v); });
+    }
+    wrap_batch_access(wrapped);
+    wrap_parallel_algorithms(wrapped);
     wrapped.module().unset_override_module();
     WrapVectorImpl<T>::wrap(wrapped);
   }
 };
 
+namespace detail
+{
+  template<typename T>
+  void check_same_size(const std::valarray<T>& a, const std::valarray<T>& b)
+  {
+    if(a.size() != b.size())
+    {
+      throw std::runtime_error("Valarrays of length " + std::to_string(a.size()) + " and " + std::to_string(b.size()) + " have different lengths");
+    }
+  }
+
+  template<typename T>
+  void check_not_empty(const std::valarray<T>& a)
+  {
+    if(a.size() == 0)
+    {
+      throw std::runtime_error("Valarray is empty");
+    }
+  }
+
+  /// Throw if a[i] / b[i] is undefined for an integer type: division by zero, or the minimum value divided by -1
+  template<typename T>
+  void check_integer_division(const T a, const T b)
+  {
+    if(b == 0)
+    {
+      throw std::runtime_error("Integer division by zero");
+    }
+    if constexpr(std::is_signed_v<T>)
+    {
+      if(b == T(-1) && a == std::numeric_limits<T>::min())
+      {
+        throw std::runtime_error("Integer overflow dividing " + std::to_string(a) + " by -1");
+      }
+    }
+  }
+
+  template<typename T>
+  void check_integer_division(const std::valarray<T>& a, const T x)
+  {
+    const std::size_t n = a.size();
+    for(std::size_t i = 0; i != n; ++i)
+    {
+      check_integer_division(a[i], x);
+    }
+    if(n == 0)
+    {
+      check_integer_division(T(0), x);
+    }
+  }
+
+  template<typename T>
+  void check_integer_division(const std::valarray<T>& a, const std::valarray<T>& b)
+  {
+    const std::size_t n = a.size();
+    for(std::size_t i = 0; i != n; ++i)
+    {
+      check_integer_division(a[i], b[i]);
+    }
+  }
+
+  /// Throw if shifting a T by x bits is undefined: negative counts or counts of at least the bit width of T
+  template<typename T>
+  void check_shift(const std::valarray<T>&, const T x)
+  {
+    constexpr int nb_bits = std::numeric_limits<T>::digits + (std::is_signed_v<T> ? 1 : 0);
+    bool in_range = x < T(nb_bits);
+    if constexpr(std::is_signed_v<T>)
+    {
+      in_range = in_range && x >= 0;
+    }
+    if(!in_range)
+    {
+      throw std::runtime_error("Shift by " + std::to_string(x) + " is out of range for " + std::to_string(nb_bits) + "-bit integers");
+    }
+  }
+
+  template<typename T>
+  void check_shift(const std::valarray<T>& a, const std::valarray<T>& b)
+  {
+    const std::size_t n = b.size();
+    for(std::size_t i = 0; i != n; ++i)
+    {
+      check_shift(a, b[i]);
+    }
+  }
+
+  inline std::size_t slice_length(const std::slice& s)
+  {
+    return s.size();
+  }
+
+  inline std::size_t slice_length(const std::gslice& s)
+  {
+    const std::valarray<std::size_t> sizes = s.size();
+    return sizes.size() == 0 ? 0 : std::accumulate(std::begin(sizes), std::end(sizes), std::size_t(1), std::multiplies<std::size_t>());
+  }
+
+  template<typename T>
+  void check_slice_length(const std::size_t length, const std::valarray<T>& w)
+  {
+    if(length != w.size())
+    {
+      throw std::runtime_error("Slice of length " + std::to_string(length) + " does not match the valarray of length " + std::to_string(w.size()));
+    }
+  }
+
+  /// Throw if any index selected by the slice is not below size
+  inline void check_slice(const std::size_t size, const std::slice& s)
+  {
+    if(s.size() != 0 && s.start() + (s.size() - 1) * s.stride() >= size)
+    {
+      throw std::runtime_error("Slice is out of bounds for a valarray of length " + std::to_string(size));
+    }
+  }
+
+  inline void check_slice(const std::size_t size, const std::gslice& s)
+  {
+    const std::valarray<std::size_t> sizes = s.size();
+    const std::valarray<std::size_t> strides = s.stride();
+    if(sizes.size() != strides.size())
+    {
+      throw std::runtime_error("gslice has " + std::to_string(sizes.size()) + " sizes but " + std::to_string(strides.size()) + " strides");
+    }
+    std::size_t last = s.start();
+    for(std::size_t i = 0; i != sizes.size(); ++i)
+    {
+      if(sizes[i] == 0)
+      {
+        return;
+      }
+      last += (sizes[i] - 1) * strides[i];
+    }
+    if(last >= size)
+    {
+      throw std::runtime_error("gslice is out of bounds for a valarray of length " + std::to_string(size));
+    }
+  }
+}
+
+/// Add the compound assignment operators of valarray, with a scalar or an equally long valarray on the right hand side,
+/// as valarray_add!, valarray_sub!, ... Bitwise and shift operators are only added for integer types.
+/// Integer division and shifts throw on operands for which C++ leaves the result undefined, as do valarray_min and
+/// valarray_max on an empty array. valarray_sum of an empty array is zero.
+/// Each runs as a single loop over the whole array, which the compiler can vectorize.
+template<typename TypeWrapperT>
+void wrap_valarray_arithmetic(TypeWrapperT& wrapped)
+{
+  using WrappedT = typename TypeWrapperT::type;
+  using T = typename WrappedT::value_type;
+  if constexpr(detail::is_summable_v<T>)
+  {
+    auto compound_op = [&wrapped] (const std::string& name, auto op)
+    {
+      using OpT = decltype(op);
+      wrapped.method(name, [] (WrappedT& v, const T x) { OpT()(v, x); });
+      wrapped.method(name, [] (WrappedT& v, const WrappedT& w) { detail::check_same_size(v, w); OpT()(v, w); });
+    };
+    compound_op("valarray_add!", [] (WrappedT& a, const auto& b) { a += b; });
+    compound_op("valarray_sub!", [] (WrappedT& a, const auto& b) { a -= b; });
+    compound_op("valarray_mul!", [] (WrappedT& a, const auto& b) { a *= b; });
+    if constexpr(std::is_integral_v<T>)
+    {
+      compound_op("valarray_div!", [] (WrappedT& a, const auto& b) { detail::check_integer_division(a, b); a /= b; });
+      compound_op("valarray_rem!", [] (WrappedT& a, const auto& b) { detail::check_integer_division(a, b); a %= b; });
+      compound_op("valarray_and!", [] (WrappedT& a, const auto& b) { a &= b; });
+      compound_op("valarray_or!", [] (WrappedT& a, const auto& b) { a |= b; });
+      compound_op("valarray_xor!", [] (WrappedT& a, const auto& b) { a ^= b; });
+      compound_op("valarray_shl!", [] (WrappedT& a, const auto& b) { detail::check_shift(a, b); a <<= b; });
+      compound_op("valarray_shr!", [] (WrappedT& a, const auto& b) { detail::check_shift(a, b); a >>= b; });
+    }
+    else
+    {
+      compound_op("valarray_div!", [] (WrappedT& a, const auto& b) { a /= b; });
+    }
+    // valarray::sum is undefined for an empty array, while Julia's sum of an empty numeric array is zero
+    wrapped.method("valarray_sum", [] (const WrappedT& v) { return v.size() == 0 ? T(0) : v.sum(); });
+    wrapped.method("valarray_min", [] (const WrappedT& v) { detail::check_not_empty(v); return v.min(); });
+    wrapped.method("valarray_max", [] (const WrappedT& v) { detail::check_not_empty(v); return v.max(); });
+    // f is a Julia @safe_cfunction, called once per element
+    wrapped.method("valarray_apply!", [] (WrappedT& v, T(*f)(T)) { v = v.apply(f); });
+    wrapped.method("valarray_shift", [] (const WrappedT& v, const cxxint_t n) { return WrappedT(v.shift(n)); });
+    wrapped.method("valarray_cshift", [] (const WrappedT& v, const cxxint_t n) { return WrappedT(v.cshift(n)); });
+  }
+
+  // Slices are applied immediately: v[s] copies the selected elements, and assignment and compound operators write
+  // through to v. A lazy slice_array would refer to v and could outlive it, since Julia finalizes both independently.
+  auto wrap_slice = [&wrapped] (auto slice_tag)
+  {
+    using SliceT = decltype(slice_tag);
+    wrapped.method("valarray_getslice", [] (const WrappedT& v, const SliceT& s) { detail::check_slice(v.size(), s); return WrappedT(v[s]); });
+    wrapped.method("valarray_setslice!", [] (WrappedT& v, const T x, const SliceT& s) { detail::check_slice(v.size(), s); v[s] = x; });
+    wrapped.method("valarray_setslice!", [] (WrappedT& v, const WrappedT& w, const SliceT& s)
+    {
+      detail::check_slice(v.size(), s);
+      detail::check_slice_length(detail::slice_length(s), w);
+      v[s] = w;
+    });
+    if constexpr(detail::is_summable_v<T>)
+    {
+      wrapped.method("valarray_addslice!", [] (WrappedT& v, const WrappedT& w, const SliceT& s)
+      {
+        detail::check_slice(v.size(), s);
+        detail::check_slice_length(detail::slice_length(s), w);
+        v[s] += w;
+      });
+      wrapped.method("valarray_mulslice!", [] (WrappedT& v, const WrappedT& w, const SliceT& s)
+      {
+        detail::check_slice(v.size(), s);
+        detail::check_slice_length(detail::slice_length(s), w);
+        v[s] *= w;
+      });
+    }
+  };
+  wrap_slice(std::slice());
+  wrap_slice(std::gslice());
+}
+
 template<>
 struct WrapSTLContainer<std::valarray> : STLTypeWrapperBase<WrapSTLContainer<std::valarray>>
 {
@@ -455,6 +1242,28 @@ struct WrapSTLContainer<std::valarray> : STLTypeWrapperBase<WrapSTLContainer<std
     wrapped.method("cxxgetindex", [] (const WrappedT& v, cxxint_t i) -> const_reftype<WrappedT> { return v[i-1]; });
     wrapped.method("cxxgetindex", [] (WrappedT& v, cxxint_t i) -> reftype<WrappedT> { return v[i-1]; });
     wrapped.method("cxxsetindex!", [] (WrappedT& v, const_reftype<WrappedT> val, cxxint_t i) { v[i-1] = val; });
+    // A valarray can't grow in place, so append copies both parts into a new one
+    wrapped.method("append", [] (WrappedT& v, jlcxx::ArrayRef<T> arr)
+    {
+      WrappedT result(v.size() + arr.size());
+      copy_from_array(arr, std::copy(std::begin(v), std::end(v), std::begin(result)));
+      v = std::move(result);
+    });
+    if constexpr(is_direct_arrayref_v<T>)
+    {
+      wrapped.method("assign", [] (WrappedT& v, jlcxx::ArrayRef<T> arr)
+      {
+        if(v.size() != arr.size())
+        {
+          v.resize(arr.size());
+        }
+        std::copy(arr.data(), arr.data() + arr.size(), std::begin(v));
+      });
+      wrapped.method("cxxcopyto!", [] (jlcxx::ArrayRef<T> dest, const WrappedT& v) { return copy_to_array(dest, v); });
+    }
+    wrap_batch_access(wrapped);
+    wrap_parallel_algorithms(wrapped);
+    wrap_valarray_arithmetic(wrapped);
     wrapped.module().unset_override_module();
   }
 };
@@ -499,12 +1308,115 @@ struct WrapSTLContainer<std::deque> : STLTypeWrapperBase<WrapSTLContainer<std::d
     wrapped.method("push_front!", [] (WrappedT& v, const_reftype<WrappedT> val) { v.push_front(val); });
     wrapped.method("pop_back!", [] (WrappedT& v) { v.pop_back(); });
     wrapped.method("pop_front!", [] (WrappedT& v) { v.pop_front(); });
+    wrapped.method("append", [] (WrappedT& v, jlcxx::ArrayRef<T> arr) { append_array(v, arr); });
+    if constexpr(is_direct_arrayref_v<T>)
+    {
+      wrapped.method("assign", [] (WrappedT& v, jlcxx::ArrayRef<T> arr) { v.assign(arr.data(), arr.data() + arr.size()); });
+      wrapped.method("cxxcopyto!", [] (jlcxx::ArrayRef<T> dest, const WrappedT& v) { return copy_to_array(dest, v); });
+    }
+    wrap_batch_access(wrapped);
+    wrap_parallel_algorithms(wrapped);
     wrapped.method("iteratorbegin", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.begin()}; });
     wrapped.method("iteratorend", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.end()}; });
     wrapped.module().unset_override_module();
   }
 };
 
+namespace detail
+{
+  /// The element that is removed next by pop() on a container adaptor
+  template<typename T, typename ContainerT>
+  decltype(auto) adaptor_next(const std::queue<T, ContainerT>& q)
+  {
+    return q.front();
+  }
+
+  template<typename AdaptorT>
+  decltype(auto) adaptor_next(const AdaptorT& a)
+  {
+    return a.top();
+  }
+
+  /// Access to the protected container and comparison of a priority_queue, for bulk heap operations
+  template<typename PriorityQueueT>
+  struct PriorityQueueAccess : PriorityQueueT
+  {
+    static typename PriorityQueueT::container_type& container(PriorityQueueT& q)
+    {
+      return q.*(&PriorityQueueAccess::c);
+    }
+
+    static typename PriorityQueueT::value_compare& compare(PriorityQueueT& q)
+    {
+      return q.*(&PriorityQueueAccess::comp);
+    }
+  };
+
+  template<typename AdaptorT, typename T>
+  void push_all(AdaptorT& a, const T* src, const std::size_t n)
+  {
+    for(std::size_t i = 0; i != n; ++i)
+    {
+      a.push(src[i]);
+    }
+  }
+
+  /// Pushing n elements one by one costs O(n log(size+n)) and rebuilding the heap O(size+n), so rebuild for large batches
+  template<typename T, typename ContainerT, typename CompareT>
+  void push_all(std::priority_queue<T, ContainerT, CompareT>& q, const T* src, const std::size_t n)
+  {
+    using AccessT = PriorityQueueAccess<std::priority_queue<T, ContainerT, CompareT>>;
+    if(n < q.size())
+    {
+      for(std::size_t i = 0; i != n; ++i)
+      {
+        q.push(src[i]);
+      }
+      return;
+    }
+    auto& c = AccessT::container(q);
+    c.insert(c.end(), src, src + n);
+    std::make_heap(c.begin(), c.end(), AccessT::compare(q));
+  }
+}
+
+/// Add methods that move whole arrays in and out of a queue, stack or priority_queue, named with the given prefix:
+/// - push_all!(v, src) pushes all elements of src in order
+/// - pop_n!(dest, v) pops up to length(dest) elements into dest, in pop order, and returns the number of popped elements
+/// - drain!(v) pops all elements into a new Julia array
+template<typename TypeWrapperT>
+void wrap_adaptor_bulk(TypeWrapperT& wrapped, const std::string& prefix)
+{
+  using WrappedT = typename TypeWrapperT::type;
+  using T = typename WrappedT::value_type;
+  if constexpr(is_direct_arrayref_v<T>)
+  {
+    wrapped.method(prefix + "push_all!", [] (WrappedT& v, ArrayRef<T> src) { detail::push_all(v, src.data(), src.size()); });
+    wrapped.method(prefix + "pop_n!", [] (ArrayRef<T> dest, WrappedT& v)
+    {
+      const std::size_t n = std::min(dest.size(), v.size());
+      T* out = dest.data();
+      for(std::size_t i = 0; i != n; ++i)
+      {
+        out[i] = detail::adaptor_next(v);
+        v.pop();
+      }
+      return cxxint_t(n);
+    });
+    wrapped.method(prefix + "drain!", [] (WrappedT& v)
+    {
+      Array<T> result(v.size());
+      T* out = jlcxx_array_data<T>(result.wrapped());
+      for(std::size_t i = 0; !v.empty(); ++i)
+      {
+        out[i] = detail::adaptor_next(v);
+        v.pop();
+      }
+      return result;
+    });
+  }
+}
+
 template<typename T>
 struct WrapQueueImpl
 {
@@ -519,6 +1431,7 @@ struct WrapQueueImpl
     wrapped.method("push_back!", [] (WrappedT& v, const_reftype<WrappedT> val) { v.push(val); });
     wrapped.method("front", [] (WrappedT& v) { return v.front(); });
     wrapped.method("pop_front!", [] (WrappedT& v) { v.pop(); });
+    wrap_adaptor_bulk(wrapped, "q_");
     wrapped.module().unset_override_module();
   }
 };
@@ -564,7 +1477,16 @@ struct WrapSTLContainer<std::priority_queue> : STLTypeWrapperBase<WrapSTLContain
       wrapped.method("pq_top", [] (WrappedT& v) { return v.top(); });
     }
     wrapped.method("pq_isempty", [] (WrappedT& v) { return v.empty(); });
+    wrap_adaptor_bulk(wrapped, "pq_");
     wrapped.module().unset_override_module();
+    if constexpr(is_direct_arrayref_v<T>)
+    {
+      // Build the heap in O(n) from an array
+      wrapped.constructor([] (ArrayRef<T> src)
+      {
+        return new WrappedT(typename WrappedT::value_compare(), typename WrappedT::container_type(src.data(), src.data() + src.size()));
+      });
+    }
   }
 };
 
@@ -587,6 +1509,7 @@ struct WrapSTLContainer<std::stack> : STLTypeWrapperBase<WrapSTLContainer<std::s
     wrapped.method("stack_push!", [] (WrappedT& v, const_reftype<WrappedT> val) { v.push(val); });
     wrapped.method("stack_top", [] (WrappedT& v) { return v.top(); });
     wrapped.method("stack_pop!", [] (WrappedT& v) { v.pop(); });
+    wrap_adaptor_bulk(wrapped, "stack_");
     wrapped.module().unset_override_module();
   }
 };
@@ -604,6 +1527,7 @@ struct WrapSTLContainer<std::set> : STLTypeWrapperBase<WrapSTLContainer<std::set
     using T = typename WrappedT::value_type;
 
     wrap_range_based_bsearch(wrapped);
+    wrap_chunked_iteration(wrapped);
     wrapped.template constructor<>();
     wrapped.module().set_override_module(stl_module());
     wrapped.method("cppsize", &WrappedT::size);
@@ -612,6 +1536,7 @@ struct WrapSTLContainer<std::set> : STLTypeWrapperBase<WrapSTLContainer<std::set
     wrapped.method("set_isempty", [] (WrappedT& v) { return v.empty(); });
     wrapped.method("set_delete!", [] (WrappedT&v, const_reftype<WrappedT> val) { v.erase(val); });
     wrapped.method("set_in", [] (WrappedT& v, const_reftype<WrappedT> val) { return v.count(val) != 0; });
+    wrap_set_bulk(wrapped, "set_");
     wrapped.method("iteratorbegin", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.begin()}; });
     wrapped.method("iteratorend", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.end()}; });
 #ifdef JLCXX_HAS_RANGES
@@ -637,6 +1562,7 @@ struct WrapSTLContainer<std::unordered_set> : STLTypeWrapperBase<WrapSTLContaine
     using WrappedT = typename TypeWrapperT::type;
     using T = typename WrappedT::value_type;
 
+    wrap_chunked_iteration(wrapped);
     wrapped.template constructor<>();
     wrapped.module().set_override_module(stl_module());
     wrapped.method("cppsize", &WrappedT::size);
@@ -645,6 +1571,7 @@ struct WrapSTLContainer<std::unordered_set> : STLTypeWrapperBase<WrapSTLContaine
     wrapped.method("set_isempty", [] (WrappedT& v) { return v.empty(); });
     wrapped.method("set_delete!", [] (WrappedT&v, const_reftype<WrappedT> val) { v.erase(val); });
     wrapped.method("set_in", [] (WrappedT& v, const_reftype<WrappedT> val) { return v.count(val) != 0; });
+    wrap_set_bulk(wrapped, "set_");
     wrapped.method("iteratorbegin", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.begin()}; });
     wrapped.method("iteratorend", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.end()}; });
     wrapped.module().unset_override_module();
@@ -664,6 +1591,7 @@ struct WrapSTLContainer<std::multiset> : STLTypeWrapperBase<WrapSTLContainer<std
     using T = typename WrappedT::value_type;
 
     wrap_range_based_bsearch(wrapped);
+    wrap_chunked_iteration(wrapped);
     wrapped.template constructor<>();
     wrapped.module().set_override_module(stl_module());
     wrapped.method("cppsize", &WrappedT::size);
@@ -673,6 +1601,7 @@ struct WrapSTLContainer<std::multiset> : STLTypeWrapperBase<WrapSTLContainer<std
     wrapped.method("multiset_delete!", [] (WrappedT&v, const_reftype<WrappedT> val) { v.erase(val); });
     wrapped.method("multiset_in", [] (WrappedT& v, const_reftype<WrappedT> val) { return v.count(val) != 0; });
     wrapped.method("multiset_count", [] (WrappedT& v, const_reftype<WrappedT> val) { return v.count(val); });
+    wrap_set_bulk(wrapped, "multiset_");
     wrapped.method("iteratorbegin", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.begin()}; });
     wrapped.method("iteratorend", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.end()}; });
 #ifdef JLCXX_HAS_RANGES
@@ -698,6 +1627,7 @@ struct WrapSTLContainer<std::unordered_multiset> : STLTypeWrapperBase<WrapSTLCon
     using WrappedT = typename TypeWrapperT::type;
     using T = typename WrappedT::value_type;
 
+    wrap_chunked_iteration(wrapped);
     wrapped.template constructor<>();
     wrapped.module().set_override_module(stl_module());
     wrapped.method("cppsize", &WrappedT::size);
@@ -707,6 +1637,7 @@ struct WrapSTLContainer<std::unordered_multiset> : STLTypeWrapperBase<WrapSTLCon
     wrapped.method("multiset_delete!", [] (WrappedT&v, const_reftype<WrappedT> val) { v.erase(val); });
     wrapped.method("multiset_in", [] (WrappedT& v, const_reftype<WrappedT> val) { return v.count(val) != 0; });
     wrapped.method("multiset_count", [] (WrappedT& v, const_reftype<WrappedT> val) { return v.count(val); });
+    wrap_set_bulk(wrapped, "multiset_");
     wrapped.method("iteratorbegin", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.begin()}; });
     wrapped.method("iteratorend", [] (WrappedT& v) { return iterator_wrapper_type<WrappedT>{v.end()}; });
     wrapped.module().unset_override_module();
@@ -727,6 +1658,7 @@ struct WrapSTLContainer<std::list> : STLTypeWrapperBase<WrapSTLContainer<std::li
 
     wrap_range_based_fill(wrapped);
     wrap_range_based_bsearch(wrapped);
+    wrap_chunked_iteration(wrapped);
     wrapped.template constructor<>();
     wrapped.module().set_override_module(stl_module());\
     wrapped.method("cppsize", &WrappedT::size);
@@ -765,6 +1697,7 @@ struct WrapSTLContainer<std::forward_list> : STLTypeWrapperBase<WrapSTLContainer
     using T = typename WrappedT::value_type;
 
     wrap_range_based_fill(wrapped);
+    wrap_chunked_iteration(wrapped);
     wrapped.template constructor<>();
     wrapped.module().set_override_module(stl_module());
     wrapped.method("flist_empty!", [] (WrappedT& v) { v.clear(); });
@@ -778,6 +1711,209 @@ struct WrapSTLContainer<std::forward_list> : STLTypeWrapperBase<WrapSTLContainer
   }
 };
 
+/// Wraps std::map, std::unordered_map and std::multimap. The methods are shared, prefixed with map_:
+/// - map_haskey, map_get (throws if the key is missing), map_insert! (replaces the value, except for multimap),
+///   map_delete!, map_count, map_isempty and map_empty!
+/// - map_insert_all!(m, keys, values) inserts the pairs from two equally long arrays
+/// - map_get_all!(values, found, m, keys) sets found[i] (a Vector{Bool}) to whether keys[i] is in m and if so values[i]
+///   to its value
+/// - map_export!(keys, values, m) copies all pairs into two arrays of length(m)
+/// - map_reserve! and map_rehash!, for unordered_map
+/// map_get_all! and map_export! need value types (and key types for export) that are stored directly in Julia arrays.
+template<template<typename...> class MapT>
+struct WrapSTLMap
+{
+  static std::string name();
+
+  TypeWrapper2& typewrapper()
+  {
+    if(!has_map_wrapper(name()))
+    {
+      Module& stl = registry().current_module();
+      assert(stl.name() == "StdLib");
+      set_map_wrapper(stl, name(), (jl_value_t*)jl_any_type);
+    }
+    return get_map_wrapper(name());
+  }
+
+  /// Insert a pair, replacing the value of an existing key except for multimaps
+  template<typename WrappedT>
+  static void insert(WrappedT& m, const typename WrappedT::key_type& k, const typename WrappedT::mapped_type& v)
+  {
+    using K = typename WrappedT::key_type;
+    using V = typename WrappedT::mapped_type;
+    if constexpr(std::is_same_v<MapT<K,V>, std::multimap<K,V>>)
+    {
+      m.emplace(k, v);
+    }
+    else
+    {
+      m.insert_or_assign(k, v);
+    }
+  }
+
+  void declare_types()
+  {
+    typewrapper();
+  }
+
+  template<typename... TypeLists>
+  void apply_combination()
+  {
+    typewrapper().template apply_combination<MapT, TypeLists...>(*this);
+  }
+
+  template<typename AppliedT>
+  void apply(Module& module)
+  {
+    TypeWrapper2(module, typewrapper()).template apply<AppliedT>(*this);
+  }
+
+  template<typename TypeWrapperT>
+  void operator()(TypeWrapperT&& wrapped)
+  {
+    using WrappedT = typename TypeWrapperT::type;
+    using K = typename WrappedT::key_type;
+    using V = typename WrappedT::mapped_type;
+    constexpr bool is_unordered = jlcxx::detail::has_reserve_v<WrappedT>;
+
+    wrapped.template constructor<>();
+    wrapped.module().set_override_module(stl_module());
+    wrapped.method("cppsize", &WrappedT::size);
+    wrapped.method("map_isempty", [] (const WrappedT& m) { return m.empty(); });
+    wrapped.method("map_empty!", [] (WrappedT& m) { m.clear(); });
+    wrapped.method("map_haskey", [] (const WrappedT& m, const K& k) { return m.find(k) != m.end(); });
+    wrapped.method("map_count", [] (const WrappedT& m, const K& k) { return cxxint_t(m.count(k)); });
+    wrapped.method("map_get", [] (const WrappedT& m, const K& k) -> V
+    {
+      auto it = m.find(k);
+      if(it == m.end())
+      {
+        throw std::runtime_error("Key not found in " + name());
+      }
+      return it->second;
+    });
+    wrapped.method("map_insert!", [] (WrappedT& m, const K& k, const V& v) { insert(m, k, v); });
+    wrapped.method("map_delete!", [] (WrappedT& m, const K& k) { return cxxint_t(m.erase(k)); });
+    wrapped.method("map_insert_all!", [] (WrappedT& m, ArrayRef<K> keys, ArrayRef<V> values)
+    {
+      check_indices_length(values.size(), keys.size());
+      if constexpr(is_unordered)
+      {
+        m.reserve(m.size() + keys.size());
+      }
+      for(std::size_t i = 0; i != keys.size(); ++i)
+      {
+        insert(m, keys[i], values[i]);
+      }
+    });
+    if constexpr(is_direct_arrayref_v<V>)
+    {
+      wrapped.method("map_get_all!", [] (ArrayRef<V> values, jl_value_t* found, const WrappedT& m, ArrayRef<K> keys)
+      {
+        check_indices_length(values.size(), keys.size());
+        bool* found_out = bool_array_data(found, keys.size());
+        V* values_out = values.data();
+        const auto end = m.end();
+        for(std::size_t i = 0; i != keys.size(); ++i)
+        {
+          auto it = m.find(keys[i]);
+          found_out[i] = it != end;
+          if(it != end)
+          {
+            values_out[i] = it->second;
+          }
+        }
+      });
+      if constexpr(is_direct_arrayref_v<K>)
+      {
+        wrapped.method("map_export!", [] (ArrayRef<K> keys, ArrayRef<V> values, const WrappedT& m)
+        {
+          check_indices_length(keys.size(), m.size());
+          check_indices_length(values.size(), m.size());
+          K* keys_out = keys.data();
+          V* values_out = values.data();
+          for(const auto& [k, v] : m)
+          {
+            *keys_out++ = k;
+            *values_out++ = v;
+          }
+        });
+      }
+    }
+    if constexpr(is_unordered)
+    {
+      wrapped.method("map_reserve!", [] (WrappedT& m, const cxxint_t n) { m.reserve(n); });
+      wrapped.method("map_rehash!", [] (WrappedT& m, const cxxint_t n) { m.rehash(n); });
+    }
+    wrapped.module().unset_override_module();
+  }
+};
+
+template<> inline std::string WrapSTLMap<std::map>::name() { return "StdMap"; }
+template<> inline std::string WrapSTLMap<std::unordered_map>::name() { return "StdUnorderedMap"; }
+template<> inline std::string WrapSTLMap<std::multimap>::name() { return "StdMultimap"; }
+
+namespace detail
+{
+  template<typename AppliedT>
+  void instantiate_deferred()
+  {
+    create_if_not_exists<AppliedT>();
+  }
+
+  template<std::size_t NbParameters, typename AppliedT>
+  struct DeferTypes
+  {
+    static void apply(const std::string& name)
+    {
+      static constexpr std::size_t nb_cpp_parameters = parameter_list<AppliedT>::nb_parameters;
+      jlcxx::detail::create_parameter_types<NbParameters>(parameter_list<AppliedT>(), std::make_index_sequence<nb_cpp_parameters>());
+      jl_svec_t* params = parameter_list<AppliedT>()(NbParameters);
+      std::vector<jl_value_t*> parameters(NbParameters);
+      for(std::size_t i = 0; i != NbParameters; ++i)
+      {
+        parameters[i] = jl_svecref(params, i);
+      }
+      add_deferred_type(name, std::move(parameters), instantiate_deferred<AppliedT>);
+    }
+  };
+
+  template<std::size_t NbParameters, typename... TypesT>
+  struct DeferTypes<NbParameters, ParameterList<TypesT...>>
+  {
+    static void apply(const std::string& name)
+    {
+      (DeferTypes<NbParameters, TypesT>::apply(name), ...);
+    }
+  };
+}
+
+/// Wrap ContainerT for all combinations of the given type lists. If lazy_stl() is set, only the generic types are
+/// created and each combination is wrapped when it is first used, either through julia_type or from Julia using
+/// instantiate_stl_type.
+template<template<typename...> class ContainerT, typename... TypeLists, typename WrapT>
+void apply_stl_combination(WrapT&& wrap)
+{
+  if(!lazy_stl())
+  {
+    wrap.template apply_combination<TypeLists...>();
+    return;
+  }
+  wrap.declare_types();
+  detail::DeferTypes<sizeof...(TypeLists), combine_types<ApplyType<ContainerT>, TypeLists...>>::apply(wrap.name());
+}
+
+/// Wrap the maps that are registered up front: MapT<int64_t,double> and MapT<std::string,int>. Combining all of stltypes
+/// for keys and values would add hundreds of types per map, so other maps are wrapped by stl_map_type_factory when
+/// julia_type is first called for them.
+template<template<typename...> class MapT>
+void apply_stl_maps()
+{
+  apply_stl_combination<MapT, ParameterList<int64_t>, ParameterList<double>>(WrapSTLMap<MapT>());
+  apply_stl_combination<MapT, ParameterList<std::string>, ParameterList<int>>(WrapSTLMap<MapT>());
+}
+
 template<template<typename...> class ContainerT, typename T, typename... Args>
 struct stl_container_type_factory
 {
@@ -797,6 +1933,25 @@ struct stl_container_type_factory
   }
 };
 
+template<template<typename...> class MapT, typename K, typename V, typename... Args>
+struct stl_map_type_factory
+{
+  using MappedT = MapT<K,V,Args...>;
+
+  static inline jl_datatype_t* julia_type()
+  {
+    create_if_not_exists<K>();
+    create_if_not_exists<V>();
+    assert(!has_julia_type<MappedT>());
+    assert(registry().has_current_module());
+    Module& curmod = registry().current_module();
+    WrapSTLMap<MapT> wrap;
+    wrap.template apply<MappedT>(curmod);
+    assert(has_julia_type<MappedT>());
+    return stored_type<MappedT>().get_dt();
+  }
+};
+
 }
 
 template<typename... Args> struct julia_type_factory<std::vector<Args...>>             : stl::stl_container_type_factory<std::vector,Args...> {};
@@ -811,6 +1966,9 @@ template<typename... Args> struct julia_type_factory<std::multiset<Args...>>
 template<typename... Args> struct julia_type_factory<std::unordered_multiset<Args...>> : stl::stl_container_type_factory<std::unordered_multiset,Args...> {};
 template<typename... Args> struct julia_type_factory<std::list<Args...>>               : stl::stl_container_type_factory<std::list,Args...> {};
 template<typename... Args> struct julia_type_factory<std::forward_list<Args...>>       : stl::stl_container_type_factory<std::forward_list,Args...> {};
+template<typename... Args> struct julia_type_factory<std::map<Args...>>                : stl::stl_map_type_factory<std::map,Args...> {};
+template<typename... Args> struct julia_type_factory<std::unordered_map<Args...>>      : stl::stl_map_type_factory<std::unordered_map,Args...> {};
+template<typename... Args> struct julia_type_factory<std::multimap<Args...>>           : stl::stl_map_type_factory<std::multimap,Args...> {};
 
 }
 
@@ -3,10 +3,12 @@
 
 #include "julia_headers.hpp"
 
+#include <atomic>
 #include <complex>
 #include <map>
 #include <unordered_map>
 #include <memory>
+#include <new>
 #include <stack>
 #include <stdexcept>
 #include <string>
@@ -15,7 +17,9 @@
 #include <type_traits>
 #include <iostream>
 
+#include "allocators.hpp"
 #include "jlcxx_config.hpp"
+#include "profiling.hpp"
 
 namespace jlcxx
 {
@@ -39,7 +43,45 @@ using cxxint_t = typename detail::IndexT<sizeof(long)>::type;
 
 JLCXX_API void protect_from_gc(jl_value_t* v);
 JLCXX_API void unprotect_from_gc(jl_value_t* v);
+/// Protect a value for the rest of the program, e.g. a datatype or name created during registration. It can't be unprotected.
+JLCXX_API void protect_from_gc_permanent(jl_value_t* v);
 JLCXX_API void cxx_root_scanner(int);
+JLCXX_API void cxx_post_gc(int);
+
+/// Account for memory allocated outside of the Julia heap by an object owned by Julia. Requests a collection when the
+/// external memory allocated since the last collection exceeds both the external gc interval and the external
+/// memory that was live after the last collection. The collection runs at the next call to collect_if_requested.
+JLCXX_API void report_external_allocation(std::size_t bytes);
+/// Undo report_external_allocation when the owning object is destroyed
+JLCXX_API void report_external_free(std::size_t bytes);
+/// Report the external memory of obj and remember it, so report_external_object_free can undo exactly this report
+JLCXX_API void report_external_object(const void* obj, std::size_t bytes);
+/// Undo report_external_object for obj. Does nothing for objects that were not reported, e.g. ones without a finalizer
+JLCXX_API void report_external_object_free(const void* obj);
+
+namespace detail
+{
+  /// Set by report_external_allocation when a collection is due
+  extern JLCXX_API std::atomic<bool> g_collection_requested;
+}
+
+/// Run the collection requested by report_external_allocation. Only call this through collect_if_requested
+JLCXX_API void run_requested_collection();
+
+/// Run the collection requested by report_external_allocation, if any. Only call this where all Julia values in use
+/// are rooted, such as the entry of a wrapped function, where the arguments are rooted by the Julia caller.
+inline void collect_if_requested()
+{
+  if(detail::g_collection_requested.load(std::memory_order_relaxed))
+  {
+    run_requested_collection();
+  }
+}
+
+/// Total external memory currently reported, in bytes
+JLCXX_API std::int64_t external_allocated_bytes();
+/// Minimum external allocation, in bytes, between collections triggered by report_external_allocation
+JLCXX_API void set_external_gc_interval(std::size_t bytes);
 
 template<typename T>
 inline void protect_from_gc(T* x)
@@ -47,6 +89,12 @@ inline void protect_from_gc(T* x)
   protect_from_gc((jl_value_t*)x);
 }
 
+template<typename T>
+inline void protect_from_gc_permanent(T* x)
+{
+  protect_from_gc_permanent((jl_value_t*)x);
+}
+
 template<typename T>
 inline void unprotect_from_gc(T* x)
 {
@@ -299,7 +347,7 @@ struct JLCXX_API CachedDatatype
     m_dt = dt;
     if(m_dt != nullptr && protect)
     {
-      protect_from_gc(m_dt);
+      protect_from_gc_permanent(m_dt);
     }
   }
 
@@ -426,6 +474,7 @@ void create_if_not_exists()
   {
     if(!has_julia_type<nonconst_t>())
     {
+      profiling::Scope profile_scope("create_if_not_exists", [] { return std::string(typeid(nonconst_t).name()); });
       create_julia_type<nonconst_t>();
     }
     exists = true;
@@ -597,13 +646,136 @@ inline std::pair<jl_datatype_t*,jl_datatype_t*> julia_return_type()
 // Needed for Visual C++, static members are different in each DLL
 extern "C" JLCXX_API jl_module_t* get_cxxwrap_module();
 
+struct SpecializedFinalizer {};
+
+/// Deletes C++ objects owned by Julia. Specialize to customize the destruction of a type
+template<typename T, typename Specializer=SpecializedFinalizer>
+struct Finalizer
+{
+  static void finalize(T* to_delete)
+  {
+    Allocator<T>::deallocate(to_delete);
+  }
+};
+
+/// Finalize objects of type T directly from the GC using a C function pointer, instead of calling the Julia function
+/// CxxWrap.delete, which dispatches to __delete and calls back into Finalizer<T>::finalize. Defaults to false, or to
+/// true for all types if JLCXX_DIRECT_FINALIZERS is defined. Finalizer<T> must not call into Julia when this is enabled.
+template<typename T>
+struct DirectFinalizer :
+#ifdef JLCXX_DIRECT_FINALIZERS
+  std::true_type
+#else
+  std::false_type
+#endif
+{
+};
+
+/// Specialize with a static function std::size_t size(const T&) returning the memory owned by an object outside of
+/// itself, e.g. the capacity of a buffer. The size is reported to the GC when Julia takes ownership of the object and
+/// removed when it is deleted, so Julia collects objects holding large buffers in time. Only objects boxed with a
+/// finalizer are counted, and the size reported for them is the one removed again.
+template<typename T>
+struct ExternalSize
+{
+};
+
+/// Store objects of type T in the Julia object itself, instead of in a separate heap allocation referenced by the
+/// cpp_object pointer. The box type gets a second field cpp_storage holding the bytes of the object, and cpp_object
+/// points to it, so references and pointers to the object stay valid as long as the box is rooted. No finalizer is
+/// attached. Opt-in only, for small classes that are trivially copyable and trivially destructible.
+template<typename T>
+struct InlineStorage : std::false_type
+{
+};
+
 namespace detail
 {
+  template<typename T, typename = void>
+  struct HasExternalSize : std::false_type
+  {
+  };
+
+  template<typename T>
+  struct HasExternalSize<T, std::void_t<decltype(ExternalSize<T>::size(std::declval<const T&>()))>> : std::true_type
+  {
+  };
+
+  template<typename T>
+  inline void report_external_size(const T* obj)
+  {
+    if constexpr(HasExternalSize<T>::value)
+    {
+      if(obj != nullptr)
+      {
+        report_external_object(obj, ExternalSize<T>::size(*obj));
+      }
+    }
+  }
+
+  /// Only removes the size reported by report_external_size, so deleting an object that Julia doesn't own is a no-op
+  template<typename T>
+  inline void unreport_external_size(const T* obj)
+  {
+    if constexpr(HasExternalSize<T>::value)
+    {
+      if(obj != nullptr)
+      {
+        report_external_object_free(obj);
+      }
+    }
+  }
+
+  template<typename T>
+  constexpr bool check_inline_storage()
+  {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "InlineStorage requires a trivially copyable and trivially destructible type");
+    static_assert(alignof(T) <= alignof(void*), "InlineStorage is not supported for over-aligned types");
+    return true;
+  }
+
+  /// Number of 64-bit words in the cpp_storage field of an inline box
+  template<typename T>
+  constexpr std::size_t inline_storage_words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
   inline jl_value_t* get_finalizer()
   {
     static jl_value_t* finalizer = jl_get_function(get_cxxwrap_module(), "delete");
     return finalizer;
   }
+
+  /// Thread-local state of the current Julia thread
+  inline jl_ptls_t current_ptls()
+  {
+#if (JULIA_VERSION_MAJOR * 100 + JULIA_VERSION_MINOR) >= 107
+    return jl_current_task->ptls;
+#else
+    return jl_get_ptls_states();
+#endif
+  }
+
+  /// C finalizer for a boxed pointer to T. Clears the pointer like CxxWrap.delete, so a finalizer that already ran
+  /// through an explicit call to finalize doesn't delete the object twice
+  template<typename T>
+  void direct_finalizer(void* boxed)
+  {
+    void*& cpp_ptr = *reinterpret_cast<void**>(boxed);
+    T* to_delete = static_cast<T*>(cpp_ptr);
+    cpp_ptr = nullptr;
+    if(to_delete == nullptr)
+    {
+      return;
+    }
+    try
+    {
+      unreport_external_size(to_delete);
+      Finalizer<T>::finalize(to_delete);
+    }
+    catch(const std::exception& e)
+    {
+      std::cerr << "Error finalizing C++ object of type " << typeid(T).name() << ": " << e.what() << std::endl;
+    }
+  }
 }
 
 /// Wrap a C++ pointer in a Julia type that contains a single void pointer field, returning the result as an any
@@ -615,6 +787,11 @@ BoxedValue<T> boxed_cpp_pointer(T* cpp_ptr, jl_datatype_t* dt, bool add_finalize
   assert(jl_is_cpointer_type(jl_field_type(dt,0)));
   assert(jl_datatype_size(jl_field_type(dt,0)) == sizeof(T*));
 
+  if(add_finalizer)
+  {
+    detail::report_external_size(cpp_ptr);
+  }
+
   jl_value_t *result = jl_new_struct_uninit(dt);
   struct boxed_void_ptr { const void* ptr; } *presult = (struct boxed_void_ptr*)result, vresult = {cpp_ptr};
   *presult = vresult;
@@ -622,18 +799,46 @@ BoxedValue<T> boxed_cpp_pointer(T* cpp_ptr, jl_datatype_t* dt, bool add_finalize
   if(add_finalizer)
   {
     JL_GC_PUSH1(&result);
-    jl_gc_add_finalizer(result, detail::get_finalizer());
+    if constexpr(DirectFinalizer<T>::value && std::is_destructible_v<T>)
+    {
+      jl_gc_add_ptr_finalizer(detail::current_ptls(), result, reinterpret_cast<void*>(&detail::direct_finalizer<T>));
+    }
+    else
+    {
+      jl_gc_add_finalizer(result, detail::get_finalizer());
+    }
     JL_GC_POP();
   }
   
   return {result};
 }
 
+/// Construct a T inside a new Julia object of type dt, which must have been created for a type with InlineStorage
+template<typename T, typename... ArgsT>
+BoxedValue<T> boxed_cpp_inline(jl_datatype_t* dt, ArgsT&&... args)
+{
+  static_assert(InlineStorage<T>::value && detail::check_inline_storage<T>());
+  assert(jl_datatype_nfields(dt) == 2);
+  assert(jl_datatype_size(jl_field_type(dt, 1)) >= sizeof(T));
+
+  // The storage field is 8-byte aligned, so on 32-bit targets there is padding after the pointer
+  const std::size_t storage_offset = jl_field_offset(dt, 1);
+  assert(storage_offset >= sizeof(void*) && storage_offset % alignof(T) == 0);
+
+  jl_value_t* result = jl_new_struct_uninit(dt);
+  void* storage = reinterpret_cast<char*>(result) + storage_offset;
+  new(storage) T(std::forward<ArgsT>(args)...);
+  *reinterpret_cast<void**>(result) = storage;
+  return {result};
+}
+
 /// Transfer ownership of a regular pointer to Julia
 template<typename T>
 BoxedValue<T> julia_owned(T* cpp_ptr)
 {
   static_assert(!std::is_fundamental_v<T>, "Ownership can't be transferred for fundamental types");
+  static_assert(Allocator<T>::uses_operator_new, "Ownership can't be transferred for types with a custom Allocator, use create instead");
+  static_assert(!InlineStorage<T>::value, "Ownership can't be transferred for types with InlineStorage");
   const bool finalize = true;
   return boxed_cpp_pointer(cpp_ptr, julia_type<T>(), finalize);
 }
@@ -649,7 +854,14 @@ struct ConvertToJulia
   {
     static_assert(std::is_same_v<static_julia_type<T>, WrappedCppPtr>, "No appropriate specialization for ConvertToJulia");
     static_assert(std::is_class_v<T>, "Need class type for conversion");
-    return julia_owned(new T(std::move(cpp_val)));
+    if constexpr(InlineStorage<T>::value)
+    {
+      return boxed_cpp_inline<T>(julia_type<T>(), std::move(cpp_val));
+    }
+    else
+    {
+      return boxed_cpp_pointer(Allocator<T>::allocate(std::move(cpp_val)), julia_type<T>(), true);
+    }
   }
 };
 
@@ -785,7 +997,14 @@ struct BoxValue<CppT,WrappedCppPtr>
 {
   inline BoxedValue<CppT> operator()(CppT cppval)
   {
-    return boxed_cpp_pointer(new CppT(cppval), julia_type<CppT>(), true);
+    if constexpr(InlineStorage<CppT>::value)
+    {
+      return boxed_cpp_inline<CppT>(julia_type<CppT>(), cppval);
+    }
+    else
+    {
+      return boxed_cpp_pointer(Allocator<CppT>::allocate(cppval), julia_type<CppT>(), true);
+    }
   }
 };
 template<typename CppT>
@@ -947,7 +1166,7 @@ struct TypeVar
   static jl_tvar_t* build_tvar()
   {
     jl_tvar_t* result = jl_new_typevar(jl_symbol((std::string("T") + std::to_string(I)).c_str()), (jl_value_t*)jl_bottom_type, (jl_value_t*)jl_any_type);
-    protect_from_gc(result);
+    protect_from_gc_permanent(result);
     return result;
   }
 };
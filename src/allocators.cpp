@@ -0,0 +1,47 @@
+#include "jlcxx/allocators.hpp"
+
+#include <sstream>
+
+namespace jlcxx
+{
+
+namespace
+{
+
+struct StatsRegistry
+{
+  std::mutex mutex;
+  std::vector<const AllocationStats*> stats;
+};
+
+StatsRegistry& stats_registry()
+{
+  static StatsRegistry* registry = new StatsRegistry();
+  return *registry;
+}
+
+}
+
+JLCXX_API void register_allocation_stats(const AllocationStats* stats)
+{
+  StatsRegistry& registry = stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.stats.push_back(stats);
+}
+
+JLCXX_API std::string allocation_stats_csv()
+{
+  std::stringstream result;
+  result << "type,object_size,live_objects,live_bytes,total_allocations,reserved_bytes\n";
+  StatsRegistry& registry = stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for(const AllocationStats* stats : registry.stats)
+  {
+    const std::int64_t live_objects = stats->live_objects.load(std::memory_order_relaxed);
+    result << '"' << stats->type_name << "\"," << stats->object_size << ',' << live_objects << ',' << live_objects * std::int64_t(stats->object_size) << ','
+           << stats->total_allocations.load(std::memory_order_relaxed) << ',' << stats->reserved_bytes.load(std::memory_order_relaxed) << '\n';
+  }
+  return result.str();
+}
+
+}
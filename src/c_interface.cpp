@@ -48,6 +48,87 @@ struct GetFundamentalTypes
   ArrayRef<jl_value_t*> m_type_sizes;
 };
 
+/// Allocate a Julia array of the given element type with its final size and set the (boxed) elements in place
+template<typename T>
+jl_array_t* make_pointer_array(jl_datatype_t* element_type, const std::vector<T*>& values)
+{
+  jl_array_t* result = jl_alloc_array_1d(apply_array_type(element_type, 1), values.size());
+  for(std::size_t i = 0; i != values.size(); ++i)
+  {
+    jl_array_ptr_set(result, i, (jl_value_t*)values[i]);
+  }
+  return result;
+}
+
+/// Build the array of CppFunctionInfo structs describing the given functions
+jl_array_t* make_function_info_array(const std::vector<FunctionWrapperBase*>& functions)
+{
+  std::vector<std::vector<jl_datatype_t*>> argument_types;
+  argument_types.reserve(functions.size());
+  for(FunctionWrapperBase* f : functions)
+  {
+    argument_types.push_back(f->argument_types());
+  }
+
+  const std::size_t nb_functions = functions.size();
+  jl_datatype_t* datatype_eltype = julia_type<jl_datatype_t*>();
+  jl_datatype_t* value_eltype = julia_type<jl_value_t*>();
+
+  jl_array_t* function_array = jl_alloc_array_1d(apply_array_type(g_cppfunctioninfo_type, 1), nb_functions);
+  jl_value_t** roots;
+  JL_GC_PUSHARGS(roots, 7);
+  roots[0] = (jl_value_t*)function_array;
+
+  // Overloads often have the same argument types, so the Julia arrays for them are shared. They are
+  // reachable from function_array as soon as the first function using them is stored.
+  std::map<std::vector<jl_datatype_t*>, jl_array_t*> argument_type_arrays;
+
+  for(std::size_t i = 0; i != nb_functions; ++i)
+  {
+    FunctionWrapperBase& f = *functions[i];
+
+    jl_array_t*& arg_types_array = argument_type_arrays[argument_types[i]];
+    if(arg_types_array == nullptr)
+    {
+      arg_types_array = make_pointer_array(datatype_eltype, argument_types[i]);
+    }
+    roots[1] = (jl_value_t*)arg_types_array;
+    roots[2] = (jl_value_t*)make_pointer_array(value_eltype, f.argument_names());
+    roots[3] = (jl_value_t*)make_pointer_array(value_eltype, f.argument_default_values());
+    roots[4] = jlcxx::box<void*>(f.pointer());
+    roots[5] = jlcxx::box<void*>(f.thunk());
+    roots[6] = jlcxx::box<int>(f.number_of_keyword_arguments());
+
+    auto returntypes = f.return_type();
+
+    jl_datatype_t* ccall_return_type = returntypes.first;
+    jl_datatype_t* julia_return_type = returntypes.second;
+    if(ccall_return_type == nullptr)
+    {
+      ccall_return_type = julia_type<void>();
+      julia_return_type = ccall_return_type;
+    }
+
+    jl_value_t* cppfuncinfo = jl_new_struct(g_cppfunctioninfo_type,
+      f.name(),
+      roots[1],
+      ccall_return_type,
+      julia_return_type,
+      roots[4],
+      roots[5],
+      f.override_module(),
+      f.doc(),
+      roots[2],
+      roots[3],
+      roots[6]
+      );
+    jl_array_ptr_set(function_array, i, cppfuncinfo);
+  }
+
+  JL_GC_POP();
+  return function_array;
+}
+
 }
 
 extern "C"
@@ -68,6 +149,7 @@ JLCXX_API void initialize_cxxwrap(jl_value_t* julia_module, jl_value_t* cppfunct
   }
 
   jl_gc_set_cb_root_scanner(cxx_root_scanner, 1);
+  jl_gc_set_cb_post_gc(cxx_post_gc, 1);
 
   g_cxxwrap_module = (jl_module_t*)julia_module;
   g_cppfunctioninfo_type = (jl_datatype_t*)cppfunctioninfo_type;
@@ -80,12 +162,16 @@ JLCXX_API void register_julia_module(jl_module_t* jlmod, void (*regfunc)(jlcxx::
 {
   try
   {
+    profiling::ModuleScope profile_module(module_name(jlmod));
+    profiling::Scope profile_scope("register_julia_module", [jlmod] { return module_name(jlmod); });
     jlcxx::Module& mod = jlcxx::registry().create_module(jlmod);
     regfunc(mod);
-    mod.for_each_function([] (FunctionWrapperBase& f) {
+    if(!mod.lazy_registration())
+    {
       // Make sure any pointers in the types are also resolved at module init.
-      f.argument_types();
-    });
+      profiling::Scope for_each_scope("for_each_function", [jlmod] { return module_name(jlmod); });
+      mod.materialize_types();
+    }
     jlcxx::registry().reset_current_module();
   }
   catch (const std::runtime_error& e)
@@ -112,86 +198,38 @@ JLCXX_API void bind_module_constants(jl_value_t* module_any, jl_value_t* symbols
   registry().get_module(mod).bind_constants(ArrayRef<jl_value_t*>((jl_array_t*)symbols), ArrayRef<jl_value_t*>((jl_array_t*)values));
 }
 
-void fill_types_vec(Array<jl_datatype_t*>& types_array, const std::vector<jl_datatype_t*>& types_vec)
+/// Get the functions defined in the modules. Any classes used by these functions must be defined on the Julia side first
+JLCXX_API jl_array_t* get_module_functions(jl_module_t* jlmod)
 {
-  for(const auto& t : types_vec)
+  profiling::ModuleScope profile_module(module_name(jlmod));
+  profiling::Scope profile_scope("get_module_functions", [jlmod] { return module_name(jlmod); });
+
+  jlcxx::Module& module = registry().get_module(jlmod);
+  module.materialize_types();
+  std::vector<FunctionWrapperBase*> functions;
+  module.for_each_function([&](FunctionWrapperBase& f)
   {
-    types_array.push_back(t);
-  }
+    functions.push_back(&f);
+  });
+
+  return make_function_info_array(functions);
 }
 
-void fill_values_vec(Array<jl_value_t*>& types_array, const std::vector<jl_value_t*>& types_vec)
+/// Get the distinct names of the functions defined in the module, so the Julia side can define them on first use.
+/// This creates no types, also in lazy registration mode.
+JLCXX_API jl_array_t* get_module_function_names(jl_module_t* jlmod)
 {
-  for(const auto& t : types_vec)
-  {
-    types_array.push_back(t);
-  }
+  jlcxx::Module& module = registry().get_module(jlmod);
+  return make_pointer_array(julia_type<jl_value_t*>(), module.function_names());
 }
 
-/// Get the functions defined in the modules. Any classes used by these functions must be defined on the Julia side first
-JLCXX_API jl_array_t* get_module_functions(jl_module_t* jlmod)
+/// Get the functions with the given name, a symbol or one of the special name types such as ConstructorFname. In lazy
+/// registration mode, the types used by these functions are created here, so get_box_types must be called again
+/// afterwards to pick up any new box types.
+JLCXX_API jl_array_t* get_module_functions_named(jl_module_t* jlmod, jl_value_t* name)
 {
-  Array<jl_value_t*> function_array(g_cppfunctioninfo_type);
-  JL_GC_PUSH1(function_array.gc_pointer());
-
-  const jlcxx::Module& module = registry().get_module(jlmod);
-  module.for_each_function([&](FunctionWrapperBase& f)
-  {
-    Array<jl_datatype_t*> arg_types_array;
-    jl_value_t* boxed_f = nullptr;
-    jl_value_t* boxed_thunk = nullptr;
-    JL_GC_PUSH3(arg_types_array.gc_pointer(), &boxed_f, &boxed_thunk);
-    {
-       Array<jl_value_t*> arg_names_array;
-       JL_GC_PUSH1(arg_names_array.gc_pointer());
-       {
-          Array<jl_value_t*> arg_default_values_array;
-          jl_value_t* boxed_n_kwargs = nullptr;
-          jl_value_t* cppfuncinfo = nullptr;
-          JL_GC_PUSH3(arg_default_values_array.gc_pointer(), &boxed_n_kwargs, &cppfuncinfo);
-
-          fill_types_vec(arg_types_array, f.argument_types());
-
-          boxed_f = jlcxx::box<void*>(f.pointer());
-          boxed_thunk = jlcxx::box<void*>(f.thunk());
-
-          fill_values_vec(arg_names_array, f.argument_names());
-          fill_values_vec(arg_default_values_array, f.argument_default_values());
-
-          boxed_n_kwargs = jlcxx::box<int>(f.number_of_keyword_arguments());
-
-          auto returntypes = f.return_type();
-
-          jl_datatype_t* ccall_return_type = returntypes.first;
-          jl_datatype_t* julia_return_type = returntypes.second;
-          if(ccall_return_type == nullptr)
-          {
-            ccall_return_type = julia_type<void>();
-            julia_return_type = ccall_return_type;
-          }
-
-          cppfuncinfo = jl_new_struct(g_cppfunctioninfo_type,
-            f.name(),
-            arg_types_array.wrapped(),
-            ccall_return_type,
-            julia_return_type,
-            boxed_f,
-            boxed_thunk,
-            f.override_module(),
-            f.doc(),
-            arg_names_array.wrapped(),
-            arg_default_values_array.wrapped(),
-            boxed_n_kwargs
-            );
-          function_array.push_back(cppfuncinfo);
-          JL_GC_POP();
-       }
-       JL_GC_POP();
-    }
-    JL_GC_POP();
-  });
-  JL_GC_POP();
-  return function_array.wrapped();
+  jlcxx::Module& module = registry().get_module(jlmod);
+  return make_function_info_array(module.functions_named(name));
 }
 
 jl_array_t* convert_type_vector(const std::vector<jl_datatype_t*> types_vec)
@@ -208,7 +246,14 @@ jl_array_t* convert_type_vector(const std::vector<jl_datatype_t*> types_vec)
 
 JLCXX_API jl_array_t* get_box_types(jl_module_t* jlmod)
 {
-  return convert_type_vector(registry().get_module(jlmod).box_types());
+  // Types created on demand for the functions may add box types, so they must exist before the Julia side wraps the types.
+  // In lazy registration mode, only the box types created so far are returned and the list grows as functions are fetched.
+  jlcxx::Module& module = registry().get_module(jlmod);
+  if(!module.lazy_registration())
+  {
+    module.materialize_types();
+  }
+  return convert_type_vector(module.box_types());
 }
 
 JLCXX_API const char* cxxwrap_version_string()
@@ -216,6 +261,28 @@ JLCXX_API const char* cxxwrap_version_string()
   return JLCXX_VERSION_STRING;
 }
 
+/// Turn the registration profile on or off, as an alternative to the JLCXX_PROFILE_REGISTRATION environment variable
+JLCXX_API void enable_registration_profiling(bool enable)
+{
+  profiling::set_enabled(enable);
+}
+
+/// Get the registration profile of all modules so far, as CSV
+JLCXX_API const char* registration_profile_csv()
+{
+  static std::string report;
+  report = profiling::report_csv();
+  return report.c_str();
+}
+
+/// Get the allocation stats of all types using a PoolAllocator, as CSV
+JLCXX_API const char* pool_allocation_stats_csv()
+{
+  static std::string report;
+  report = allocation_stats_csv();
+  return report.c_str();
+}
+
 JLCXX_API void gcprotect(jl_value_t* v)
 {
   protect_from_gc(v);
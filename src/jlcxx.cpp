@@ -5,61 +5,469 @@
 
 #include <julia_gcext.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace jlcxx
 {
 
-using cxx_gc_roots_t = std::map<jl_value_t*, int>;
-cxx_gc_roots_t& cxx_gc_roots()
+namespace
+{
+
+/// Roots that live as long as the program, such as the datatypes, names and docs created during registration.
+/// They are only ever appended, into blocks that never move: block k holds first_block_size << k roots. A root is
+/// published by incrementing m_size after it is stored, so the scanner reads the blocks without taking the lock.
+class PermanentGCRoots
+{
+public:
+  void add(jl_value_t* v)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_index.insert(v).second)
+    {
+      return;
+    }
+    const std::size_t n = m_size.load(std::memory_order_relaxed);
+    std::size_t block = 0;
+    std::size_t offset = n;
+    while(offset >= block_size(block))
+    {
+      offset -= block_size(block);
+      ++block;
+    }
+    if(block == max_blocks)
+    {
+      throw std::runtime_error("Too many permanent GC roots");
+    }
+    if(m_blocks[block] == nullptr)
+    {
+      m_blocks[block] = new jl_value_t*[block_size(block)];
+    }
+    m_blocks[block][offset] = v;
+    m_size.store(n + 1, std::memory_order_release);
+  }
+
+  template<typename F>
+  void for_each_block(F&& f) const
+  {
+    std::size_t remaining = m_size.load(std::memory_order_acquire);
+    for(std::size_t block = 0; remaining != 0; ++block)
+    {
+      const std::size_t n = std::min(remaining, block_size(block));
+      f(m_blocks[block], n);
+      remaining -= n;
+    }
+  }
+
+private:
+  static constexpr std::size_t first_block_size = 1024;
+  static constexpr std::size_t max_blocks = 40;
+
+  static constexpr std::size_t block_size(const std::size_t block)
+  {
+    return first_block_size << block;
+  }
+
+  std::mutex m_mutex;
+  std::unordered_set<jl_value_t*> m_index;
+  jl_value_t** m_blocks[max_blocks] = {};
+  std::atomic<std::size_t> m_size = 0;
+};
+
+/// Reference-counted roots, spread over shards that each have their own lock, so concurrent protect calls rarely contend.
+/// Each shard stores its roots densely for the scanner, with a hash map giving the position of each value.
+class DynamicGCRoots
+{
+public:
+  void protect(jl_value_t* v)
+  {
+    Shard& shard = shard_for(v);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Insert a "number of times protected" count of 1 or increment the count
+    auto insresult = shard.index.emplace(v, shard.roots.size());
+    if(insresult.second)
+    {
+      shard.roots.push_back(v);
+      shard.counts.push_back(1);
+    }
+    else
+    {
+      ++shard.counts[insresult.first->second];
+    }
+  }
+
+  void unprotect(jl_value_t* v)
+  {
+    Shard& shard = shard_for(v);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(v);
+    if(it == shard.index.end())
+    {
+      throw std::runtime_error("Attempt to unprotect an object that was not GC protected");
+    }
+    const std::size_t pos = it->second;
+    if(--shard.counts[pos] != 0)
+    {
+      return;
+    }
+
+    // Keep the storage dense by moving the last root into the freed slot
+    const std::size_t last = shard.roots.size() - 1;
+    if(pos != last)
+    {
+      shard.roots[pos] = shard.roots[last];
+      shard.counts[pos] = shard.counts[last];
+      shard.index[shard.roots[pos]] = pos;
+    }
+    shard.roots.pop_back();
+    shard.counts.pop_back();
+    shard.index.erase(it);
+  }
+
+  template<typename F>
+  void for_each_block(F&& f)
+  {
+    for(Shard& shard : m_shards)
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      f(shard.roots.data(), shard.roots.size());
+    }
+  }
+
+private:
+  static constexpr std::size_t nb_shards = 64;
+
+  struct alignas(64) Shard
+  {
+    std::mutex mutex;
+    std::unordered_map<jl_value_t*, std::size_t> index;
+    std::vector<jl_value_t*> roots;
+    std::vector<int> counts;
+  };
+
+  Shard& shard_for(jl_value_t* v)
+  {
+    // Julia objects are at least 16-byte aligned, so the low bits carry no information
+    return m_shards[(reinterpret_cast<std::uintptr_t>(v) >> 4) % nb_shards];
+  }
+
+  std::array<Shard, nb_shards> m_shards;
+};
+
+PermanentGCRoots& permanent_gc_roots()
+{
+  static PermanentGCRoots m_roots;
+  return m_roots;
+}
+
+DynamicGCRoots& dynamic_gc_roots()
 {
-  static cxx_gc_roots_t m_roots;
+  static DynamicGCRoots m_roots;
   return m_roots;
 }
 
+/// Memory owned by Julia objects outside of the Julia heap, as reported through report_external_allocation
+struct ExternalAllocations
+{
+  std::atomic<std::int64_t> live_bytes = 0;
+  std::atomic<std::int64_t> bytes_since_gc = 0;
+  std::atomic<std::int64_t> live_bytes_after_gc = 0;
+  std::atomic<std::int64_t> gc_interval = 64*1024*1024;
+  /// Bytes reported per object by report_external_object
+  std::mutex objects_mutex;
+  std::unordered_map<const void*, std::size_t> objects;
+};
+
+ExternalAllocations& external_allocations()
+{
+  static ExternalAllocations m_allocations;
+  return m_allocations;
+}
+
+/// C++ objects owning the memory of Julia arrays, keyed on the array or its Memory, see attach_array_owner
+struct ArrayOwners
+{
+  struct Owner
+  {
+    void* owner;
+    void (*release)(void*);
+  };
+
+  std::mutex mutex;
+  std::unordered_map<jl_value_t*, Owner> owners;
+};
+
+ArrayOwners& array_owners()
+{
+  // Never destroyed, since finalizers may still run during program exit
+  static ArrayOwners* m_owners = new ArrayOwners();
+  return *m_owners;
+}
+
+void release_array_owner(jl_value_t* arr)
+{
+  ArrayOwners::Owner owner;
+  {
+    ArrayOwners& owners = array_owners();
+    std::lock_guard<std::mutex> lock(owners.mutex);
+    auto it = owners.owners.find(arr);
+    if(it == owners.owners.end())
+    {
+      return;
+    }
+    owner = it->second;
+    owners.owners.erase(it);
+  }
+  owner.release(owner.owner);
+}
+
+}
+
 JLCXX_API jl_module_t* g_cxxwrap_module = nullptr;
 jl_datatype_t* g_cppfunctioninfo_type = nullptr;
 
-JLCXX_API void protect_from_gc(jl_value_t* v)
+JLCXX_API void attach_array_owner(jl_array_t* arr, void* owner, void (*release)(void*))
 {
-  // Insert a "number of times protected" count of 1 or increment the count
-  auto insresult = cxx_gc_roots().insert(std::make_pair(v, 1));
-  if(!insresult.second)
+#if (JULIA_VERSION_MAJOR * 100 + JULIA_VERSION_MINOR) >= 111
+  // The data belongs to the Memory of the array, which can outlive the array itself, e.g. after reshape or vec
+  jl_value_t* data_owner = (jl_value_t*)arr->ref.mem;
+#else
+  // Arrays sharing the data, e.g. from reshape, keep the original array alive
+  jl_value_t* data_owner = (jl_value_t*)arr;
+#endif
   {
-    ++(insresult.first->second);
+    ArrayOwners& owners = array_owners();
+    std::lock_guard<std::mutex> lock(owners.mutex);
+    owners.owners[data_owner] = ArrayOwners::Owner{owner, release};
   }
+  jl_gc_add_ptr_finalizer(detail::current_ptls(), data_owner, reinterpret_cast<void*>(&release_array_owner));
+}
+
+JLCXX_API void protect_from_gc(jl_value_t* v)
+{
+  dynamic_gc_roots().protect(v);
+}
+
+JLCXX_API void protect_from_gc_permanent(jl_value_t* v)
+{
+  permanent_gc_roots().add(v);
 }
 
 JLCXX_API void unprotect_from_gc(jl_value_t* v)
 {
-  auto it = cxx_gc_roots().find(v);
-  if(it == cxx_gc_roots().end())
+  dynamic_gc_roots().unprotect(v);
+}
+
+JLCXX_API void report_external_allocation(std::size_t bytes)
+{
+  ExternalAllocations& external = external_allocations();
+  const std::int64_t nb_bytes = std::int64_t(bytes);
+  external.live_bytes.fetch_add(nb_bytes, std::memory_order_relaxed);
+  const std::int64_t since_gc = external.bytes_since_gc.fetch_add(nb_bytes, std::memory_order_relaxed) + nb_bytes;
+  // Collect once the external memory could have doubled since the last collection, like the GC does for its own heap
+  const std::int64_t threshold = std::max(external.gc_interval.load(std::memory_order_relaxed), external.live_bytes_after_gc.load(std::memory_order_relaxed));
+  if(since_gc >= threshold)
+  {
+    // Reset here too, so other threads don't request a collection for the same allocations. The collection itself
+    // can't happen here, since this is called while boxing, when unrooted values of the caller may still be live.
+    external.bytes_since_gc.store(0, std::memory_order_relaxed);
+    detail::g_collection_requested.store(true, std::memory_order_relaxed);
+  }
+}
+
+namespace detail
+{
+  JLCXX_API std::atomic<bool> g_collection_requested(false);
+}
+
+JLCXX_API void run_requested_collection()
+{
+  // Finalizers may call wrapped functions, e.g. __delete, and must not start a collection themselves
+  if(detail::current_ptls()->in_finalizer)
   {
-    throw std::runtime_error("Attempt to unprotect an object that was not GC protected");
+    return;
   }
-  --(it->second);
-  if(it->second == 0)
+  if(detail::g_collection_requested.exchange(false))
   {
-    cxx_gc_roots().erase(it);
+    jl_gc_collect(JL_GC_AUTO);
   }
 }
 
-JLCXX_API void cxx_root_scanner(int)
+JLCXX_API void report_external_object(const void* obj, std::size_t bytes)
 {
-#if (JULIA_VERSION_MAJOR * 100 + JULIA_VERSION_MINOR) >= 107
-  jl_ptls_t ptls = jl_current_task->ptls;
-#else
-  jl_ptls_t ptls = jl_get_ptls_states();
-#endif
-  for(const auto rootpair : cxx_gc_roots())
   {
-    jl_gc_mark_queue_obj(ptls, rootpair.first);
+    ExternalAllocations& external = external_allocations();
+    std::lock_guard<std::mutex> lock(external.objects_mutex);
+    external.objects[obj] = bytes;
+  }
+  report_external_allocation(bytes);
+}
+
+JLCXX_API void report_external_object_free(const void* obj)
+{
+  ExternalAllocations& external = external_allocations();
+  std::size_t bytes = 0;
+  {
+    std::lock_guard<std::mutex> lock(external.objects_mutex);
+    auto it = external.objects.find(obj);
+    if(it == external.objects.end())
+    {
+      return;
+    }
+    bytes = it->second;
+    external.objects.erase(it);
   }
+  report_external_free(bytes);
+}
+
+JLCXX_API void report_external_free(std::size_t bytes)
+{
+  external_allocations().live_bytes.fetch_sub(std::int64_t(bytes), std::memory_order_relaxed);
+}
+
+JLCXX_API std::int64_t external_allocated_bytes()
+{
+  return external_allocations().live_bytes.load(std::memory_order_relaxed);
+}
+
+JLCXX_API void set_external_gc_interval(std::size_t bytes)
+{
+  external_allocations().gc_interval.store(std::int64_t(bytes), std::memory_order_relaxed);
+}
+
+JLCXX_API void cxx_post_gc(int)
+{
+  ExternalAllocations& external = external_allocations();
+  external.bytes_since_gc.store(0, std::memory_order_relaxed);
+  detail::g_collection_requested.store(false, std::memory_order_relaxed);
+  external.live_bytes_after_gc.store(external.live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+JLCXX_API void cxx_root_scanner(int)
+{
+  jl_ptls_t ptls = detail::current_ptls();
+  // Each block is queued as one object array. The parent is only used to record old-to-young references, and the
+  // empty svec has no fields to rescan.
+  auto mark_block = [ptls] (jl_value_t** roots, const std::size_t nb_roots)
+  {
+    if(nb_roots != 0)
+    {
+      jl_gc_mark_queue_objarray(ptls, (jl_value_t*)jl_emptysvec, roots, nb_roots);
+    }
+  };
+
+  permanent_gc_roots().for_each_block(mark_block);
+  dynamic_gc_roots().for_each_block(mark_block);
 }
 
 Module::Module(jl_module_t* jmod) :
   m_jl_mod(jmod),
   m_constant_values(jl_any_type)
 {
-  protect_from_gc(m_constant_values.wrapped());
+  protect_from_gc_permanent(m_constant_values.wrapped());
+  const char* lazy_env = std::getenv("JLCXX_LAZY_REGISTRATION");
+  m_lazy_registration = lazy_env != nullptr && std::string(lazy_env) != "" && std::string(lazy_env) != "0";
+}
+
+namespace
+{
+
+/// Run f with mod as the current module, since type factories add their methods to the current module and it is
+/// no longer set after registration
+template<typename F>
+void run_in_module(Module& mod, F&& f)
+{
+  ModuleRegistry& reg = registry();
+  Module* previous_module = reg.has_current_module() ? &reg.current_module() : nullptr;
+  reg.set_current_module(&mod);
+  try
+  {
+    f();
+  }
+  catch(...)
+  {
+    reg.set_current_module(previous_module);
+    throw;
+  }
+  reg.set_current_module(previous_module);
+}
+
+}
+
+void Module::materialize_types()
+{
+  if(m_nb_materialized == m_functions.size())
+  {
+    return;
+  }
+
+  run_in_module(*this, [this] ()
+  {
+    for(; m_nb_materialized != m_functions.size(); ++m_nb_materialized)
+    {
+      FunctionWrapperBase& f = *m_functions[m_nb_materialized];
+      f.argument_types();
+      f.return_type();
+    }
+  });
+}
+
+void Module::update_function_index()
+{
+  // Names are set after a function is appended, so functions are only indexed when a lookup is done
+  for(; m_nb_indexed != m_functions.size(); ++m_nb_indexed)
+  {
+    jl_value_t* name = m_functions[m_nb_indexed]->name();
+    assert(name != nullptr);
+    std::vector<std::size_t>& indices = m_function_index[jl_object_id(name)];
+    const bool is_new_name = std::none_of(indices.begin(), indices.end(), [&] (const std::size_t i) { return jl_egal(m_functions[i]->name(), name); });
+    if(is_new_name)
+    {
+      m_function_names.push_back(name);
+    }
+    indices.push_back(m_nb_indexed);
+  }
+}
+
+std::vector<FunctionWrapperBase*> Module::functions_named(jl_value_t* name)
+{
+  update_function_index();
+  std::vector<FunctionWrapperBase*> result;
+  auto found = m_function_index.find(jl_object_id(name));
+  if(found == m_function_index.end())
+  {
+    return result;
+  }
+  for(const std::size_t i : found->second)
+  {
+    if(jl_egal(m_functions[i]->name(), name))
+    {
+      result.push_back(m_functions[i].get());
+    }
+  }
+
+  // Creating the types may add functions for other names, which are indexed on the next lookup
+  run_in_module(*this, [&result] ()
+  {
+    for(FunctionWrapperBase* f : result)
+    {
+      f->argument_types();
+      f->return_type();
+    }
+  });
+  return result;
+}
+
+const std::vector<jl_value_t*>& Module::function_names()
+{
+  update_function_index();
+  return m_function_names;
 }
 
 void Module::bind_constants(ArrayRef<jl_value_t*> symbols, ArrayRef<jl_value_t*> values)
@@ -67,18 +475,23 @@ void Module::bind_constants(ArrayRef<jl_value_t*> symbols, ArrayRef<jl_value_t*>
   const std::size_t nb_consts = m_jl_constants.size();
   assert(nb_consts == jl_array_len(m_constant_values.wrapped()));
   assert(nb_consts == m_constant_names.size());
-  for(std::size_t i = 0; i != nb_consts; ++i)
+  // Symbols are never collected, so they can be kept in a C++ vector until they are appended in one go
+  std::vector<jl_value_t*> constant_symbols;
+  constant_symbols.reserve(nb_consts);
+  for(const std::string& name : m_constant_names)
   {
-    symbols.push_back((jl_value_t*)jl_symbol(m_constant_names[i].c_str()));
-    values.push_back(jl_array_ptr_ref(m_constant_values.wrapped(), i));
+    constant_symbols.push_back((jl_value_t*)jl_symbol(name.c_str()));
   }
+  symbols.append(constant_symbols.begin(), constant_symbols.end());
+  jl_value_t** constant_values = jlcxx_array_data<jl_value_t*>(m_constant_values.wrapped());
+  values.append(constant_values, constant_values + nb_consts);
 }
 
 void Module::set_constant(const std::string& name, jl_value_t* boxed_const)
 {
   JL_GC_PUSH1(&boxed_const);
   m_jl_constants[name] = m_constant_names.size();
-  m_constant_values.push_back(boxed_const);
+  m_constant_values.emplace_back_unchecked(boxed_const); // m_constant_values is protected from GC
   JL_GC_POP();
   m_constant_names.push_back(name);
 }
@@ -98,6 +511,20 @@ FunctionWrapperBase::FunctionWrapperBase(Module* mod, std::pair<jl_datatype_t*,j
 {
 }
 
+FunctionWrapperBase::FunctionWrapperBase(Module* mod, return_type_resolver_t return_type_resolver) :
+  m_name(nullptr), m_module(mod), m_return_type_resolver(return_type_resolver), m_override_module((jl_value_t*)mod->julia_module())
+{
+  if(!mod->lazy_registration())
+  {
+    return_type();
+  }
+}
+
+bool FunctionWrapperBase::lazy() const
+{
+  return m_module->lazy_registration();
+}
+
 
 Module &ModuleRegistry::create_module(jl_module_t* jmod)
 {
@@ -0,0 +1,227 @@
+#include "jlcxx/profiling.hpp"
+#include "jlcxx/julia_headers.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+namespace jlcxx
+{
+
+namespace profiling
+{
+
+namespace
+{
+
+struct Stats
+{
+  std::int64_t calls = 0;
+  std::int64_t total_ns = 0;
+  std::int64_t self_ns = 0;
+  std::int64_t julia_bytes = 0;
+};
+
+/// Measurements per (module, category, name)
+using table_t = std::map<std::tuple<std::string, std::string, std::string>, Stats>;
+
+struct Frame
+{
+  const char* category;
+  std::string name;
+  std::chrono::steady_clock::time_point start;
+  std::int64_t start_bytes;
+  std::int64_t child_ns;
+};
+
+std::int64_t julia_total_bytes()
+{
+  int64_t bytes = 0;
+  jl_gc_get_total_bytes(&bytes);
+  return bytes;
+}
+
+void write_csv_header(std::ostream& out)
+{
+  out << "module,category,name,calls,total_ns,self_ns,julia_bytes\n";
+}
+
+void write_csv(std::ostream& out, const table_t& table)
+{
+  for(const auto& [key, stats] : table)
+  {
+    const auto& [module_name, category, name] = key;
+    // Names are type names or function names, which may contain commas but no quotes
+    out << module_name << ',' << category << ",\"" << name << "\"," << stats.calls << ',' << stats.total_ns << ',' << stats.self_ns << ',' << stats.julia_bytes << '\n';
+  }
+}
+
+/// Output file from JLCXX_PROFILE_REGISTRATION, or nullptr if it is not set
+const char* output_path_from_env()
+{
+  const char* output = std::getenv("JLCXX_PROFILE_REGISTRATION");
+  return output != nullptr && output[0] != '\0' ? output : nullptr;
+}
+
+class Profiler
+{
+public:
+  Profiler()
+  {
+    if(const char* output = output_path_from_env())
+    {
+      m_output_path = output;
+    }
+  }
+
+  void begin_module(const std::string& module_name)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_current_module = module_name;
+  }
+
+  void end_module()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_output_path.empty() && !m_pending.empty())
+    {
+      write_output(m_pending);
+    }
+    for(const auto& [key, stats] : m_pending)
+    {
+      Stats& total = m_all[key];
+      total.calls += stats.calls;
+      total.total_ns += stats.total_ns;
+      total.self_ns += stats.self_ns;
+      total.julia_bytes += stats.julia_bytes;
+    }
+    m_pending.clear();
+    m_current_module = "<global>";
+  }
+
+  std::string report_csv()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::stringstream result;
+    write_csv_header(result);
+    write_csv(result, m_all);
+    write_csv(result, m_pending);
+    return result.str();
+  }
+
+  void start(const char* category, const std::string& name)
+  {
+    m_stack.push_back(Frame{category, name, std::chrono::steady_clock::now(), julia_total_bytes(), 0});
+  }
+
+  void stop()
+  {
+    const auto end = std::chrono::steady_clock::now();
+    const std::int64_t end_bytes = julia_total_bytes();
+    Frame frame = std::move(m_stack.back());
+    m_stack.pop_back();
+
+    const std::int64_t total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - frame.start).count();
+    if(!m_stack.empty())
+    {
+      m_stack.back().child_ns += total_ns;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats& stats = m_pending[std::make_tuple(m_current_module, std::string(frame.category), std::move(frame.name))];
+    ++stats.calls;
+    stats.total_ns += total_ns;
+    stats.self_ns += total_ns - frame.child_ns;
+    stats.julia_bytes += end_bytes - frame.start_bytes;
+  }
+
+private:
+  void write_output(const table_t& table)
+  {
+    if(m_output_path == "-")
+    {
+      if(!m_header_written)
+      {
+        write_csv_header(std::cerr);
+        m_header_written = true;
+      }
+      write_csv(std::cerr, table);
+      return;
+    }
+
+    std::ofstream out(m_output_path, m_header_written ? std::ios::app : std::ios::trunc);
+    if(!out)
+    {
+      std::cerr << "Warning: could not open registration profile output file " << m_output_path << std::endl;
+      return;
+    }
+    if(!m_header_written)
+    {
+      write_csv_header(out);
+      m_header_written = true;
+    }
+    write_csv(out, table);
+  }
+
+  bool m_header_written = false;
+  std::string m_output_path;
+  std::string m_current_module = "<global>";
+  std::mutex m_mutex;
+  table_t m_pending;
+  table_t m_all;
+  static thread_local std::vector<Frame> m_stack;
+};
+
+thread_local std::vector<Frame> Profiler::m_stack;
+
+Profiler& profiler()
+{
+  static Profiler m_profiler;
+  return m_profiler;
+}
+
+}
+
+JLCXX_API std::atomic<bool> g_enabled(output_path_from_env() != nullptr);
+
+JLCXX_API void set_enabled(const bool enable)
+{
+  g_enabled.store(enable, std::memory_order_relaxed);
+}
+
+JLCXX_API void begin_module(const std::string& module_name)
+{
+  profiler().begin_module(module_name);
+}
+
+JLCXX_API void end_module()
+{
+  profiler().end_module();
+}
+
+JLCXX_API std::string report_csv()
+{
+  return profiler().report_csv();
+}
+
+void Scope::start(const char* category, const std::string& name)
+{
+  profiler().start(category, name);
+}
+
+void Scope::stop()
+{
+  profiler().stop();
+}
+
+}
+
+}
@@ -1,4 +1,12 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
+#include <system_error>
 #include <thread>
 #include <vector>
 
@@ -44,6 +52,51 @@ JLCXX_API bool has_wrapper(std::string name)
   return stl_wrappers().count(name) != 0;
 }
 
+using StoredMapWrappersT = std::map<std::string, TypeWrapper2>;
+
+StoredMapWrappersT& stl_map_wrappers()
+{
+  static StoredMapWrappersT wrappers;
+  return wrappers;
+}
+
+JLCXX_API void set_map_wrapper(Module& stl, std::string name, jl_value_t* supertype)
+{
+  auto result = stl_map_wrappers().insert(std::make_pair(name, stl.add_type<Parametric<TypeVar<1>, TypeVar<2>>>(name, supertype)));
+  if(!result.second)
+  {
+    throw std::runtime_error("Type " + name + " was already mapped");
+  }
+}
+
+JLCXX_API TypeWrapper2& get_map_wrapper(std::string name)
+{
+  auto result = stl_map_wrappers().find(name);
+  if(result == stl_map_wrappers().end())
+  {
+    throw std::runtime_error("Type " + name + " was not added");
+  }
+  return result->second;
+}
+
+JLCXX_API bool has_map_wrapper(std::string name)
+{
+  return stl_map_wrappers().count(name) != 0;
+}
+
+using DeferredTypesT = std::map<std::pair<std::string, std::vector<jl_value_t*>>, void(*)()>;
+
+DeferredTypesT& deferred_types()
+{
+  static DeferredTypesT deferred;
+  return deferred;
+}
+
+JLCXX_API void add_deferred_type(const std::string& name, std::vector<jl_value_t*> parameters, void(*instantiate)())
+{
+  deferred_types()[std::make_pair(name, std::move(parameters))] = instantiate;
+}
+
 template<typename string_t>
 void wrap_string(TypeWrapper<string_t>&& wrapper)
 {
@@ -56,6 +109,117 @@ void wrap_string(TypeWrapper<string_t>&& wrapper)
   wrapper.module().method("cxxgetindex", [] (const string_t& s, cxxint_t i) { return s[i-1]; });
 }
 
+std::atomic<std::size_t> g_algorithm_threads(0);
+
+JLCXX_API void set_algorithm_threads(std::size_t n)
+{
+  g_algorithm_threads = n;
+}
+
+JLCXX_API std::size_t algorithm_threads()
+{
+  return g_algorithm_threads;
+}
+
+namespace
+{
+
+/// Worker threads for the parallel algorithms. They are started on first use, grown as needed and live until the
+/// process exits, so short algorithm calls don't pay for creating threads.
+class AlgorithmPool
+{
+public:
+  void run(const std::size_t nb_tasks, const std::function<void(std::size_t)>& task)
+  {
+    std::size_t nb_remaining = nb_tasks - 1;
+    std::mutex done_mutex;
+    std::condition_variable done;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      // The queued tasks are run by any worker, so if no more threads can be started the ones already running suffice
+      try
+      {
+        for(; m_nb_workers < nb_tasks - 1; ++m_nb_workers)
+        {
+          std::thread([this] () { work(); }).detach();
+        }
+      }
+      catch(const std::system_error&)
+      {
+        if(m_nb_workers == 0)
+        {
+          throw;
+        }
+      }
+      // Workers can't take tasks while the lock is held, so on failure the tasks queued here are still at the back
+      const std::size_t nb_queued = m_tasks.size();
+      try
+      {
+        for(std::size_t i = 1; i != nb_tasks; ++i)
+        {
+          m_tasks.push_back([&, i] ()
+          {
+            task(i);
+            std::lock_guard<std::mutex> done_lock(done_mutex);
+            if(--nb_remaining == 0)
+            {
+              done.notify_one();
+            }
+          });
+        }
+      }
+      catch(...)
+      {
+        m_tasks.erase(m_tasks.begin() + nb_queued, m_tasks.end());
+        throw;
+      }
+    }
+    m_ready.notify_all();
+    task(0);
+    std::unique_lock<std::mutex> done_lock(done_mutex);
+    done.wait(done_lock, [&] () { return nb_remaining == 0; });
+  }
+
+private:
+  void work()
+  {
+    while(true)
+    {
+      std::function<void()> next;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready.wait(lock, [this] () { return !m_tasks.empty(); });
+        next = std::move(m_tasks.front());
+        m_tasks.pop_front();
+      }
+      next();
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_ready;
+  std::deque<std::function<void()>> m_tasks;
+  std::size_t m_nb_workers = 0;
+};
+
+}
+
+JLCXX_API void run_parallel_tasks(std::size_t nb_tasks, const std::function<void(std::size_t)>& task)
+{
+  if(nb_tasks == 0)
+  {
+    return;
+  }
+  if(nb_tasks == 1)
+  {
+    task(0);
+    return;
+  }
+  // Never destroyed: the detached workers may still be waiting on it when static destructors run
+  static AlgorithmPool* pool = new AlgorithmPool();
+  pool->run(nb_tasks, task);
+}
+
 jl_module_t* g_stl_module = nullptr;
 
 JLCXX_API jl_module_t* stl_module()
@@ -64,11 +228,91 @@ JLCXX_API jl_module_t* stl_module()
   return g_stl_module;
 }
 
+bool& lazy_stl_flag()
+{
+  static bool lazy = []
+  {
+    const char* lazy_env = std::getenv("JLCXX_LAZY_STL");
+    return lazy_env != nullptr && std::string(lazy_env) != "" && std::string(lazy_env) != "0";
+  }();
+  return lazy;
+}
+
+JLCXX_API void set_lazy_stl(const bool lazy)
+{
+  lazy_stl_flag() = lazy;
+}
+
+JLCXX_API bool lazy_stl()
+{
+  return lazy_stl_flag();
+}
+
+jl_value_t* g_chunk_cursor_type = nullptr;
+
+JLCXX_API jl_value_t* chunk_cursor_type()
+{
+  assert(g_chunk_cursor_type != nullptr);
+  return g_chunk_cursor_type;
+}
+
+}
+
+/// Wrap a combination of STL container and element types that was deferred because lazy_stl() is set, e.g. StdVector{Float64}.
+/// Returns false if the type is not one of the prebuilt combinations. The Julia side must fetch the functions and box
+/// types of the StdLib module again after this returns true.
+extern "C" JLCXX_API bool instantiate_stl_type(jl_datatype_t* applied_type)
+{
+  std::vector<jl_value_t*> parameters(jl_svec_len(applied_type->parameters));
+  for(std::size_t i = 0; i != parameters.size(); ++i)
+  {
+    parameters[i] = jl_svecref(applied_type->parameters, i);
+  }
+  stl::DeferredTypesT& deferred = stl::deferred_types();
+  auto it = deferred.find(std::make_pair(std::string(jl_symbol_name(applied_type->name->name)), std::move(parameters)));
+  if(it == deferred.end())
+  {
+    return false;
+  }
+
+  // The type factories add their methods to the current module
+  ModuleRegistry& reg = registry();
+  Module* previous_module = reg.has_current_module() ? &reg.current_module() : nullptr;
+  reg.set_current_module(&reg.get_module(stl::stl_module()));
+  try
+  {
+    it->second();
+  }
+  catch(const std::exception& e)
+  {
+    reg.set_current_module(previous_module);
+    jl_error(e.what());
+  }
+  reg.set_current_module(previous_module);
+  deferred.erase(it);
+  return true;
 }
 
 JLCXX_MODULE define_cxxwrap_stl_module(jlcxx::Module& stl)
 {
   stl::g_stl_module = stl.julia_module();
+
+  // struct ChunkCursor{C} position::UInt64 end, the cursor of chunked iteration over a container of type C
+  {
+    jl_value_t* container_param = (jl_value_t*)jl_new_typevar(jl_symbol("C"), (jl_value_t*)jl_bottom_type, (jl_value_t*)jl_any_type);
+    jl_svec_t* params = nullptr;
+    jl_svec_t* fnames = nullptr;
+    jl_svec_t* ftypes = nullptr;
+    JL_GC_PUSH4(&container_param, &params, &fnames, &ftypes);
+    params = jl_svec1(container_param);
+    fnames = jl_svec1(jl_symbol("position"));
+    ftypes = jl_svec1(jl_uint64_type);
+    jl_datatype_t* cursor_dt = new_datatype(jl_symbol("ChunkCursor"), stl.julia_module(), jl_any_type, params, fnames, ftypes, 0, 0, 1);
+    protect_from_gc_permanent(cursor_dt);
+    stl::g_chunk_cursor_type = cursor_dt->name->wrapper;
+    stl.set_const("ChunkCursor", std::forward<jl_value_t*>(cursor_dt->name->wrapper));
+    JL_GC_POP();
+  }
 #ifdef JLCXX_HAS_RANGES
   stl.set_const("HAS_RANGES", 1);
 #endif
@@ -100,11 +344,32 @@ JLCXX_MODULE define_cxxwrap_stl_module(jlcxx::Module& stl)
     .method("swap", &std::thread::swap);
 
   stl.method("hardware_concurrency", [] () { return std::thread::hardware_concurrency(); });
+  stl.method("set_algorithm_threads", [] (const cxxint_t n)
+  {
+    if(n < 0)
+    {
+      throw std::runtime_error("Number of algorithm threads must not be negative");
+    }
+    jlcxx::stl::set_algorithm_threads(n);
+  });
+  stl.method("algorithm_threads", [] () { return cxxint_t(jlcxx::stl::algorithm_threads()); });
 
   jlcxx::add_smart_pointer<std::shared_ptr>(stl, "SharedPtr");
   jlcxx::add_smart_pointer<std::weak_ptr>(stl, "WeakPtr");
   jlcxx::add_smart_pointer<std::unique_ptr>(stl, "UniquePtr");
 
+  stl.add_type<std::slice>("StdSlice")
+    .constructor<std::size_t, std::size_t, std::size_t>()
+    .method("slice_start", [] (const std::slice& s) { return s.start(); })
+    .method("cppsize", [] (const std::slice& s) { return s.size(); })
+    .method("slice_stride", [] (const std::slice& s) { return s.stride(); });
+  stl.add_type<std::gslice>("StdGSlice")
+    .constructor([] (const std::size_t start, ArrayRef<std::size_t> sizes, ArrayRef<std::size_t> strides)
+    {
+      return new std::gslice(start, std::valarray<std::size_t>(sizes.data(), sizes.size()), std::valarray<std::size_t>(strides.data(), strides.size()));
+    })
+    .method("slice_start", [] (const std::gslice& s) { return s.start(); });
+
   jlcxx::stl::apply_vector();
   jlcxx::stl::apply_valarray();
   jlcxx::stl::apply_deque();
@@ -117,6 +382,9 @@ JLCXX_MODULE define_cxxwrap_stl_module(jlcxx::Module& stl)
   jlcxx::stl::apply_unordered_multiset();
   jlcxx::stl::apply_list();
   jlcxx::stl::apply_forward_list();
+  jlcxx::stl::apply_map();
+  jlcxx::stl::apply_unordered_map();
+  jlcxx::stl::apply_multimap();
 
   jlcxx::stl::apply_shared_ptr();
   jlcxx::stl::apply_weak_ptr();
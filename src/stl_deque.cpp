@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_deque()
 {
-  WrapSTLContainer<std::deque>().apply_combination<stltypes>();
+  apply_stl_combination<std::deque, stltypes>(WrapSTLContainer<std::deque>());
 }
 
 }
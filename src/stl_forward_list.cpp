@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_forward_list()
 {
-  WrapSTLContainer<std::forward_list>().apply_combination<stltypes>();
+  apply_stl_combination<std::forward_list, stltypes>(WrapSTLContainer<std::forward_list>());
 }
 
 }
@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_list()
 {
-  WrapSTLContainer<std::list>().apply_combination<stltypes>();
+  apply_stl_combination<std::list, stltypes>(WrapSTLContainer<std::list>());
 }
 
 }
@@ -0,0 +1,11 @@
+#include "jlcxx/stl.hpp"
+
+namespace jlcxx::stl
+{
+
+void apply_map()
+{
+  apply_stl_maps<std::map>();
+}
+
+}
@@ -0,0 +1,11 @@
+#include "jlcxx/stl.hpp"
+
+namespace jlcxx::stl
+{
+
+void apply_multimap()
+{
+  apply_stl_maps<std::multimap>();
+}
+
+}
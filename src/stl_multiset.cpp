@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_multiset()
 {
-  WrapSTLContainer<std::multiset>().apply_combination<stltypes>();
+  apply_stl_combination<std::multiset, stltypes>(WrapSTLContainer<std::multiset>());
 }
 
 }
@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_priority_queue()
 {
-  WrapSTLContainer<std::priority_queue>().apply_combination<stltypes>();
+  apply_stl_combination<std::priority_queue, stltypes>(WrapSTLContainer<std::priority_queue>());
 }
 
 }
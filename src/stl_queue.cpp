@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_queue()
 {
-  WrapSTLContainer<std::queue>().apply_combination<stltypes>();
+  apply_stl_combination<std::queue, stltypes>(WrapSTLContainer<std::queue>());
 }
 
 }
@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_set()
 {
-  WrapSTLContainer<std::set>().apply_combination<stltypes>();
+  apply_stl_combination<std::set, stltypes>(WrapSTLContainer<std::set>());
 }
 
 }
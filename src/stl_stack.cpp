@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_stack()
 {
-  WrapSTLContainer<std::stack>().apply_combination<stltypes>();
+  apply_stl_combination<std::stack, stltypes>(WrapSTLContainer<std::stack>());
 }
 
 }
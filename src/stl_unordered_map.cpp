@@ -0,0 +1,11 @@
+#include "jlcxx/stl.hpp"
+
+namespace jlcxx::stl
+{
+
+void apply_unordered_map()
+{
+  apply_stl_maps<std::unordered_map>();
+}
+
+}
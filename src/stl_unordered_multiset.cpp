@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_unordered_multiset()
 {
-  WrapSTLContainer<std::unordered_multiset>().apply_combination<stltypes>();
+  apply_stl_combination<std::unordered_multiset, stltypes>(WrapSTLContainer<std::unordered_multiset>());
 }
 
 }
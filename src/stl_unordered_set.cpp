@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_unordered_set()
 {
-  WrapSTLContainer<std::unordered_set>().apply_combination<stltypes>();
+  apply_stl_combination<std::unordered_set, stltypes>(WrapSTLContainer<std::unordered_set>());
 }
 
 }
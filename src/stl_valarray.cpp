@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_valarray()
 {
-  WrapSTLContainer<std::valarray>().apply_combination<stltypes>();
+  apply_stl_combination<std::valarray, stltypes>(WrapSTLContainer<std::valarray>());
 }
 
 }
@@ -5,7 +5,7 @@ namespace jlcxx::stl
 
 void apply_vector()
 {
-  WrapSTLContainer<std::vector>().apply_combination<stltypes>();
+  apply_stl_combination<std::vector, stltypes>(WrapSTLContainer<std::vector>());
 }
 
 }
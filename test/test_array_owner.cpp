@@ -0,0 +1,97 @@
+#include <jlcxx/jlcxx.hpp>
+
+#include <vector>
+
+// Arrays created from a std::vector without copying must keep the vector alive as long as any alias of the data is
+// reachable. On Julia 1.11 and later, reshape creates a new Array sharing the Memory, so the original Array can be
+// collected while the data is still in use.
+
+namespace test_array_owner
+{
+
+constexpr int64_t nb_values = 1000000;
+
+}
+
+JLCXX_MODULE register_array_owner_module(jlcxx::Module& mod)
+{
+  using namespace test_array_owner;
+
+  mod.method("make_vector", [] ()
+  {
+    std::vector<double> values(nb_values);
+    for(int64_t i = 0; i != nb_values; ++i)
+    {
+      values[i] = double(i);
+    }
+    return jlcxx::to_julia_array(std::move(values));
+  });
+}
+
+bool check_exception()
+{
+  if(jl_exception_occurred())
+  {
+    jl_call2(jl_get_function(jl_base_module, "showerror"), jl_stderr_obj(), jl_exception_occurred());
+    jl_printf(jl_stderr_stream(), "\n");
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  using namespace test_array_owner;
+
+  jlcxx::cxxwrap_init();
+
+  jl_value_t* mod = jl_eval_string(R"(
+    module ArrayOwnerModule
+      const __cxxwrap_pointers = Ptr{Cvoid}[]
+      using CxxWrap
+    end
+  )");
+  JL_GC_PUSH1(&mod);
+
+  register_julia_module((jl_module_t*)mod, register_array_owner_module);
+  jl_call1(jl_get_function(jlcxx::get_cxxwrap_module(), "wraptypes"), mod);
+  jl_call1(jl_get_function(jlcxx::get_cxxwrap_module(), "wrapfunctions"), mod);
+
+  // Only the reshaped alias is kept, the array returned by make_vector is garbage right away
+  jl_eval_string("reshaped_values = reshape(ArrayOwnerModule.make_vector(), 1000, :)");
+  jl_eval_string("GC.gc(); GC.gc()");
+  if(!check_exception())
+  {
+    return 1;
+  }
+  if(jlcxx::external_allocated_bytes() < nb_values * int64_t(sizeof(double)))
+  {
+    std::cout << "vector was released while a reshaped alias is still alive" << std::endl;
+    return 1;
+  }
+
+  const std::string expected_sum = std::to_string(nb_values * (nb_values - 1) / 2);
+  jl_value_t* sum_ok = jl_eval_string(("sum(reshaped_values) == " + expected_sum).c_str());
+  if(!check_exception() || !jl_unbox_bool(sum_ok))
+  {
+    std::cout << "wrong contents in the reshaped alias" << std::endl;
+    return 1;
+  }
+
+  jl_eval_string("reshaped_values = nothing");
+  jl_eval_string("GC.gc(); GC.gc()");
+  if(!check_exception())
+  {
+    return 1;
+  }
+  if(jlcxx::external_allocated_bytes() != 0)
+  {
+    std::cout << "vector was not released after the last alias was collected" << std::endl;
+    return 1;
+  }
+
+  JL_GC_POP();
+
+  jl_atexit_hook(0);
+  return 0;
+}
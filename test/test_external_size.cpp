@@ -0,0 +1,136 @@
+#include <jlcxx/jlcxx.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+  #include <sys/resource.h>
+#endif
+
+// Allocates many wrapped objects owning large buffers, through a constructor and through a function returning them by
+// value. Without reporting their size the GC only sees small boxes and doesn't collect them, so the peak memory use
+// would grow with the total size of all buffers.
+
+namespace test_external_size
+{
+
+constexpr std::size_t buffer_size = 16*1024*1024;
+constexpr int nb_buffers = 400;
+
+struct Buffer
+{
+  Buffer(const int64_t size) : data(size)
+  {
+    // Touch each page, so the buffer counts in the resident set
+    for(std::size_t i = 0; i < data.size(); i += 4096)
+    {
+      data[i] = 1;
+    }
+  }
+
+  std::vector<char> data;
+};
+
+/// Peak resident set size in MiB, or 0 if unknown
+double peak_rss_mib()
+{
+#ifdef _WIN32
+  return 0.0;
+#else
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return double(usage.ru_maxrss) / (1024.0*1024.0);
+#else
+  return double(usage.ru_maxrss) / 1024.0;
+#endif
+#endif
+}
+
+}
+
+namespace jlcxx
+{
+  template<> struct ExternalSize<test_external_size::Buffer>
+  {
+    static std::size_t size(const test_external_size::Buffer& b)
+    {
+      return b.data.capacity();
+    }
+  };
+}
+
+JLCXX_MODULE register_external_size_module(jlcxx::Module& mod)
+{
+  using namespace test_external_size;
+
+  mod.add_type<Buffer>("Buffer")
+    .constructor<int64_t>()
+    .method("buffer_length", [] (const Buffer& b) { return int64_t(b.data.size()); });
+  mod.method("make_buffer", [] (const int64_t size) { return Buffer(size); });
+  // Returned as a pointer, so Julia doesn't own it and its size is not reported
+  mod.method("make_unowned_buffer", [] (const int64_t size) { return new Buffer(size); });
+}
+
+/// Evaluate a loop allocating nb_buffers buffers and return the peak RSS, or a negative number on error
+double run_loop(const std::string& name, const std::string& make_buffer)
+{
+  using namespace test_external_size;
+  const std::string loop = "let total = 0; for i in 1:" + std::to_string(nb_buffers) + "; total += ExternalSizeModule.buffer_length(" + make_buffer + "(" + std::to_string(buffer_size) + ")); end; total; end";
+  jl_value_t* total = jl_eval_string(loop.c_str());
+  if(jl_exception_occurred())
+  {
+    jl_call2(jl_get_function(jl_base_module, "showerror"), jl_stderr_obj(), jl_exception_occurred());
+    jl_printf(jl_stderr_stream(), "\n");
+    return -1.0;
+  }
+  const double allocated_mib = double(jl_unbox_int64(total)) / (1024.0*1024.0);
+  const double peak_mib = peak_rss_mib();
+  std::cout << name << ": allocated " << allocated_mib << " MiB in total, peak RSS " << peak_mib << " MiB" << std::endl;
+  return peak_mib;
+}
+
+int main()
+{
+  jlcxx::cxxwrap_init();
+
+  jl_value_t* mod = jl_eval_string(R"(
+    module ExternalSizeModule
+      const __cxxwrap_pointers = Ptr{Cvoid}[]
+      using CxxWrap
+    end
+  )");
+  JL_GC_PUSH1(&mod);
+
+  register_julia_module((jl_module_t*)mod, register_external_size_module);
+  jl_call1(jl_get_function(jlcxx::get_cxxwrap_module(), "wraptypes"), mod);
+  jl_call1(jl_get_function(jlcxx::get_cxxwrap_module(), "wrapfunctions"), mod);
+
+  // Julia itself uses a few hundred MiB, the buffers should add no more than a few times the collection interval.
+  // The peak RSS never decreases, so the by-value loop only fails if it needs more than the constructor loop did.
+  bool ok = true;
+  const std::pair<std::string, std::string> loops[] = {{"constructor", "ExternalSizeModule.Buffer"}, {"by-value factory", "ExternalSizeModule.make_buffer"}};
+  for(const auto& [name, make_buffer] : loops)
+  {
+    const double peak_mib = run_loop(name, make_buffer);
+    if(peak_mib < 0.0 || peak_mib > 1024.0)
+    {
+      std::cout << name << ": peak RSS too high, wrapped objects were not collected in time" << std::endl;
+      ok = false;
+    }
+  }
+
+  // Deleting an object whose size was never reported must not change the reported total
+  const int64_t bytes_before = jlcxx::external_allocated_bytes();
+  jl_eval_string("CxxWrap.delete(ExternalSizeModule.make_unowned_buffer(1024))");
+  if(jl_exception_occurred() || jlcxx::external_allocated_bytes() != bytes_before)
+  {
+    std::cout << "deleting an unowned buffer changed the external size from " << bytes_before << " to " << jlcxx::external_allocated_bytes() << std::endl;
+    ok = false;
+  }
+
+  JL_GC_POP();
+  jl_atexit_hook(0);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+#include <jlcxx/jlcxx.hpp>
+#include <jlcxx/functions.hpp>
+
+#include <chrono>
+#include <set>
+
+// Check get_module_functions on a large module, with many overloads sharing the same argument types. Overloads with
+// identical argument types must share one Julia array for them, which is what keeps the function table small.
+// The timing is compared with baseline_module_functions, the implementation from before the one-pass construction.
+
+extern "C" JLCXX_API jl_array_t* get_module_functions(jl_module_t* jlmod);
+
+namespace test_module_functions
+{
+
+constexpr int nb_groups = 3000;
+
+void push_values(jlcxx::Array<jl_value_t*>& array, const std::vector<jl_value_t*>& values)
+{
+  for(jl_value_t* v : values)
+  {
+    array.push_back(v);
+  }
+}
+
+/// The previous get_module_functions: it grows every array one element at a time, allocates a separate argument
+/// type array per function and pushes new GC roots for each function
+jl_array_t* baseline_module_functions(jl_module_t* jlmod, jl_datatype_t* cppfunctioninfo_type)
+{
+  jlcxx::Array<jl_value_t*> function_array(cppfunctioninfo_type);
+  JL_GC_PUSH1(function_array.gc_pointer());
+
+  jlcxx::registry().get_module(jlmod).for_each_function([&](jlcxx::FunctionWrapperBase& f)
+  {
+    jlcxx::Array<jl_datatype_t*> arg_types_array;
+    jlcxx::Array<jl_value_t*> arg_names_array;
+    jlcxx::Array<jl_value_t*> arg_default_values_array;
+    jl_value_t* boxed_f = nullptr;
+    jl_value_t* boxed_thunk = nullptr;
+    jl_value_t* boxed_n_kwargs = nullptr;
+    JL_GC_PUSH6(arg_types_array.gc_pointer(), arg_names_array.gc_pointer(), arg_default_values_array.gc_pointer(), &boxed_f, &boxed_thunk, &boxed_n_kwargs);
+
+    for(jl_datatype_t* t : f.argument_types())
+    {
+      arg_types_array.push_back(t);
+    }
+    boxed_f = jlcxx::box<void*>(f.pointer());
+    boxed_thunk = jlcxx::box<void*>(f.thunk());
+    push_values(arg_names_array, f.argument_names());
+    push_values(arg_default_values_array, f.argument_default_values());
+    boxed_n_kwargs = jlcxx::box<int>(f.number_of_keyword_arguments());
+
+    auto returntypes = f.return_type();
+    jl_datatype_t* ccall_return_type = returntypes.first;
+    jl_datatype_t* julia_return_type = returntypes.second;
+    if(ccall_return_type == nullptr)
+    {
+      ccall_return_type = jlcxx::julia_type<void>();
+      julia_return_type = ccall_return_type;
+    }
+
+    function_array.push_back(jl_new_struct(cppfunctioninfo_type,
+      f.name(),
+      arg_types_array.wrapped(),
+      ccall_return_type,
+      julia_return_type,
+      boxed_f,
+      boxed_thunk,
+      f.override_module(),
+      f.doc(),
+      arg_names_array.wrapped(),
+      arg_default_values_array.wrapped(),
+      boxed_n_kwargs));
+    JL_GC_POP();
+  });
+
+  JL_GC_POP();
+  return function_array.wrapped();
+}
+
+struct Foo
+{
+  int x = 0;
+};
+
+}
+
+JLCXX_MODULE register_large_module(jlcxx::Module& mod)
+{
+  using namespace test_module_functions;
+
+  mod.add_type<Foo>("Foo");
+  for(int i = 0; i != nb_groups; ++i)
+  {
+    const std::string suffix = std::to_string(i);
+    mod.method("f_" + suffix, [] () { return 1; });
+    mod.method("f_" + suffix, [] (double a, double b) { return a + b; });
+    mod.method("g_" + suffix, [] (Foo& foo, int a) { return foo.x + a; }, jlcxx::arg("foo"), jlcxx::arg("a"));
+    mod.method("g_" + suffix, [] (const Foo& foo, int a, double b) { return foo.x + a + b; }, jlcxx::arg("foo"), jlcxx::kwarg("a") = 1, jlcxx::kwarg("b") = 2.0);
+  }
+}
+
+int main()
+{
+  using namespace test_module_functions;
+
+  jlcxx::cxxwrap_init();
+
+  jl_value_t* mod = jl_eval_string(R"(
+    module LargeModule
+      const __cxxwrap_pointers = Ptr{Cvoid}[]
+      using CxxWrap
+    end
+  )");
+  jl_array_t* functions = nullptr;
+  jl_array_t* baseline_functions = nullptr;
+  JL_GC_PUSH3(&mod, &functions, &baseline_functions);
+  bool ok = true;
+
+  const auto start_register = std::chrono::steady_clock::now();
+  register_julia_module((jl_module_t*)mod, register_large_module);
+  jl_call1(jl_get_function(jlcxx::get_cxxwrap_module(), "wraptypes"), mod);
+  const auto start_functions = std::chrono::steady_clock::now();
+  functions = get_module_functions((jl_module_t*)mod);
+  const auto end_functions = std::chrono::steady_clock::now();
+  const std::size_t nb_functions = jl_array_len(functions);
+  if(nb_functions != 0)
+  {
+    baseline_functions = baseline_module_functions((jl_module_t*)mod, (jl_datatype_t*)jl_typeof(jl_array_ptr_ref(functions, 0)));
+  }
+  const auto end_baseline = std::chrono::steady_clock::now();
+
+  const auto ms = [] (auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  std::cout << "register_julia_module and wraptypes: " << ms(start_functions - start_register) << " ms" << std::endl;
+  std::cout << "get_module_functions: " << ms(end_functions - start_functions) << " ms for " << nb_functions << " functions" << std::endl;
+  std::cout << "baseline get_module_functions: " << ms(end_baseline - end_functions) << " ms" << std::endl;
+
+  // Each group adds 4 functions, on top of the constructors and finalizer of Foo
+  if(nb_functions < std::size_t(4*nb_groups))
+  {
+    std::cout << "unexpected number of functions: " << nb_functions << std::endl;
+    ok = false;
+  }
+  else if(baseline_functions == nullptr || jl_array_len(baseline_functions) != nb_functions)
+  {
+    std::cout << "baseline returned a different number of functions" << std::endl;
+    ok = false;
+  }
+
+  // The argument_types field of CppFunctionInfo is shared between functions with the same signature, so the groups
+  // only add 4 distinct arrays in total. Allow some margin for the constructors and finalizer of Foo.
+  std::set<jl_value_t*> argument_type_arrays;
+  for(std::size_t i = 0; ok && i != nb_functions; ++i)
+  {
+    argument_type_arrays.insert(jl_get_nth_field(jl_array_ptr_ref(functions, i), 1));
+  }
+  std::cout << "distinct argument type arrays: " << argument_type_arrays.size() << std::endl;
+  if(ok && argument_type_arrays.size() > 16)
+  {
+    std::cout << "argument type arrays are not shared between overloads" << std::endl;
+    ok = false;
+  }
+
+  JL_GC_POP();
+
+  jl_atexit_hook(0);
+  return ok ? 0 : 1;
+}
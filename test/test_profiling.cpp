@@ -0,0 +1,88 @@
+#include <jlcxx/jlcxx.hpp>
+#include <jlcxx/profiling.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// Registration profiling: this test runs with JLCXX_PROFILE_REGISTRATION set to a file path, so registering a module
+// must write its measurements to that file as CSV.
+
+namespace test_profiling
+{
+
+struct Foo
+{
+  int x = 0;
+};
+
+}
+
+JLCXX_MODULE register_profiled_module(jlcxx::Module& mod)
+{
+  using namespace test_profiling;
+
+  mod.add_type<Foo>("Foo")
+    .method("getx", [] (const Foo& foo) { return foo.x; });
+  mod.method("add", [] (double a, double b) { return a + b; });
+}
+
+int main()
+{
+  const char* output_path = std::getenv("JLCXX_PROFILE_REGISTRATION");
+  if(output_path == nullptr || output_path[0] == '\0' || std::string(output_path) == "-")
+  {
+    std::cout << "JLCXX_PROFILE_REGISTRATION must be set to a file path" << std::endl;
+    return 1;
+  }
+
+  jlcxx::cxxwrap_init();
+  bool ok = true;
+
+  if(!jlcxx::profiling::enabled())
+  {
+    std::cout << "profiling is not enabled by JLCXX_PROFILE_REGISTRATION" << std::endl;
+    ok = false;
+  }
+
+  jl_value_t* mod = jl_eval_string(R"(
+    module ProfiledModule
+      const __cxxwrap_pointers = Ptr{Cvoid}[]
+      using CxxWrap
+    end
+  )");
+  if(jl_exception_occurred() || mod == nullptr)
+  {
+    std::cout << "could not create the Julia module" << std::endl;
+    ok = false;
+  }
+  else
+  {
+    JL_GC_PUSH1(&mod);
+    register_julia_module((jl_module_t*)mod, register_profiled_module);
+    JL_GC_POP();
+  }
+
+  std::ifstream in(output_path);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  const std::string csv = contents.str();
+  if(csv.rfind("module,category,name,calls,total_ns,self_ns,julia_bytes\n", 0) != 0)
+  {
+    std::cout << "profile output " << output_path << " has no CSV header" << std::endl;
+    ok = false;
+  }
+  if(csv.find("\nProfiledModule,register_julia_module,") == std::string::npos)
+  {
+    std::cout << "profile output has no register_julia_module row for ProfiledModule:" << std::endl << csv << std::endl;
+    ok = false;
+  }
+  if(jlcxx::profiling::report_csv().find("ProfiledModule,") == std::string::npos)
+  {
+    std::cout << "report_csv has no rows for ProfiledModule" << std::endl;
+    ok = false;
+  }
+
+  jl_atexit_hook(0);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+#include <jlcxx/jlcxx.hpp>
+#include <jlcxx/stl.hpp>
+
+// Bulk methods of the STL wrappers: results must match element-wise access, bounds and sizes must be checked, and inputs
+// longer than parallel_grain_size must take the same path as short ones. Methods that write boolean results must
+// accept a plain Julia Vector{Bool}.
+
+/// Evaluate a Julia expression that must return true
+bool check(const char* name, const char* expression)
+{
+  jl_value_t* result = jl_eval_string(expression);
+  if(jl_exception_occurred())
+  {
+    std::cout << name << ": ";
+    std::cout.flush();
+    jl_call2(jl_get_function(jl_base_module, "showerror"), jl_stderr_obj(), jl_exception_occurred());
+    jl_printf(jl_stderr_stream(), "\n");
+    return false;
+  }
+  if(result == nullptr || !jl_is_bool(result) || !jl_unbox_bool(result))
+  {
+    std::cout << name << " failed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  jlcxx::cxxwrap_init();
+  // C++ exceptions thrown by the wrappers arrive as ErrorException
+  jl_eval_string("throws_error(f) = try f(); false; catch e; e isa ErrorException; end");
+
+  bool ok = check("set_in!", R"(
+    let s = CxxWrap.StdLib.StdSet{Int64}(), keys = collect(Int64, 1:10), found = Vector{Bool}(undef, 10)
+      for i in 1:2:10; push!(s, i); end
+      CxxWrap.StdLib.set_in!(found, s, keys) === found && found == isodd.(keys)
+    end
+  )");
+  ok &= check("set_in! wrong output type", R"(
+    let s = CxxWrap.StdLib.StdSet{Int64}()
+      try
+        CxxWrap.StdLib.set_in!(zeros(3), s, collect(Int64, 1:3))
+        false
+      catch e
+        e isa ErrorException
+      end
+    end
+  )");
+  ok &= check("map_get_all!", R"(
+    let m = CxxWrap.StdLib.StdUnorderedMap{Int64,Float64}(), keys = collect(Int64, 1:10), vals = zeros(10), found = Vector{Bool}(undef, 10)
+      CxxWrap.StdLib.map_insert_all!(m, collect(Int64, 2:2:10), collect(2.0:2.0:10.0))
+      CxxWrap.StdLib.map_get_all!(vals, found, m, keys)
+      found == iseven.(keys) && vals[found] == collect(2.0:2.0:10.0)
+    end
+  )");
+  ok &= check("cxxgetrange! and cxxsetrange!", R"(
+    let n = 100_000, v = CxxWrap.StdLib.StdVector{Int64}(), dest = zeros(Int64, n - 10)
+      CxxWrap.StdLib.append(v, collect(Int64, 1:n))
+      CxxWrap.StdLib.cxxgetrange!(v, dest, 6)
+      read_ok = dest == collect(Int64, 6:n-5)
+      CxxWrap.StdLib.cxxsetrange!(v, -dest, 11)
+      read_ok && v[10] == 10 && [v[i] for i in 11:n] == -dest
+    end
+  )");
+  ok &= check("cxxgetrange! and cxxsetrange! bounds", R"(
+    let v = CxxWrap.StdLib.StdVector{Int64}()
+      CxxWrap.StdLib.append(v, collect(Int64, 1:10))
+      throws_error(() -> CxxWrap.StdLib.cxxgetrange!(v, zeros(Int64, 5), 7)) &&
+        throws_error(() -> CxxWrap.StdLib.cxxgetrange!(v, zeros(Int64, 1), 0)) &&
+        throws_error(() -> CxxWrap.StdLib.cxxsetrange!(v, zeros(Int64, 11), 1)) &&
+        throws_error(() -> CxxWrap.StdLib.cxxsetrange!(v, zeros(Int64, 1), 11)) &&
+        CxxWrap.StdLib.cxxgetrange!(v, zeros(Int64, 0), 11) === nothing &&
+        [v[i] for i in 1:10] == collect(Int64, 1:10)
+    end
+  )");
+  ok &= check("cxxgetindices! and cxxsetindices!", R"(
+    let n = 100_000, v = CxxWrap.StdLib.StdVector{Int64}(), indices = collect(Int64, n:-3:1), dest = zeros(Int64, length(indices))
+      CxxWrap.StdLib.append(v, collect(Int64, 1:n))
+      CxxWrap.StdLib.cxxgetindices!(v, dest, indices)
+      read_ok = dest == indices
+      CxxWrap.StdLib.cxxsetindices!(v, zeros(Int64, length(indices)), indices)
+      read_ok && all(i -> v[i] == ((n - i) % 3 == 0 ? 0 : i), 1:n)
+    end
+  )");
+  ok &= check("cxxgetindices! and cxxsetindices! bounds", R"(
+    let v = CxxWrap.StdLib.StdVector{Int64}()
+      CxxWrap.StdLib.append(v, collect(Int64, 1:10))
+      throws_error(() -> CxxWrap.StdLib.cxxgetindices!(v, zeros(Int64, 2), Int64[1, 11])) &&
+        throws_error(() -> CxxWrap.StdLib.cxxgetindices!(v, zeros(Int64, 2), Int64[0, 1])) &&
+        throws_error(() -> CxxWrap.StdLib.cxxgetindices!(v, zeros(Int64, 3), Int64[1, 2])) &&
+        throws_error(() -> CxxWrap.StdLib.cxxsetindices!(v, zeros(Int64, 1), Int64[-1])) &&
+        throws_error(() -> CxxWrap.StdLib.cxxsetindices!(v, zeros(Int64, 1), Int64[1, 2]))
+    end
+  )");
+  ok &= check("chunk_cursor and chunk_next!", R"(
+    let n = 100_000, s = CxxWrap.StdLib.StdSet{Int64}(), l = CxxWrap.StdLib.StdList{Int64}(), chunk = zeros(Int64, 4096)
+      read_all(c) = begin
+        result = Int64[]
+        cursor = Ref(CxxWrap.StdLib.chunk_cursor(c))
+        while true
+          m = CxxWrap.StdLib.chunk_next!(c, chunk, cursor)
+          append!(result, view(chunk, 1:m))
+          m < length(chunk) && return result
+        end
+      end
+      CxxWrap.StdLib.set_insert_all!(s, collect(Int64, n:-1:1))
+      for i in 1:n; CxxWrap.StdLib.list_push_back!(l, 2i); end
+      cursor = CxxWrap.StdLib.chunk_cursor(s)
+      isbits(cursor) && cursor isa CxxWrap.StdLib.ChunkCursor &&
+        read_all(s) == collect(Int64, 1:n) && read_all(l) == collect(Int64, 2:2:2n) &&
+        read_all(CxxWrap.StdLib.StdSet{Int64}()) == Int64[]
+    end
+  )");
+  ok &= check("chunk_next! rejects a cursor of another container type", R"(
+    let s = CxxWrap.StdLib.StdSet{Int64}(), l = CxxWrap.StdLib.StdList{Int64}()
+      try
+        CxxWrap.StdLib.chunk_next!(l, zeros(Int64, 1), Ref(CxxWrap.StdLib.chunk_cursor(s)))
+        false
+      catch e
+        e isa MethodError
+      end
+    end
+  )");
+  ok &= check("iterator_copy_n!", R"(
+    let n = 100_000, s = CxxWrap.StdLib.StdSet{Int64}(), chunk = zeros(Int64, 1000), result = Int64[]
+      CxxWrap.StdLib.set_insert_all!(s, collect(Int64, 1:n))
+      it = CxxWrap.StdLib.iteratorbegin(s)
+      e = CxxWrap.StdLib.iteratorend(s)
+      empty_ok = CxxWrap.StdLib.iterator_copy_n!(it, e, zeros(Int64, 0)) == 0
+      while (m = CxxWrap.StdLib.iterator_copy_n!(it, e, chunk)) > 0
+        append!(result, view(chunk, 1:m))
+      end
+      empty_ok && result == collect(Int64, 1:n) && CxxWrap.StdLib.iterator_copy_n!(it, e, chunk) == 0
+    end
+  )");
+  ok &= check("pq_push_all! small and large batches", R"(
+    let n = 100_000, q = CxxWrap.StdLib.StdPriorityQueue{Int64}(), keys = mod.(collect(Int64, 0:n-1) .* 7919, n)
+      # The heap is rebuilt for batches at least as long as the queue, the others are pushed one by one
+      CxxWrap.StdLib.pq_push_all!(q, Int64[5, 1, 9])
+      CxxWrap.StdLib.pq_push_all!(q, Int64[7, 3])
+      CxxWrap.StdLib.pq_push_all!(q, keys)
+      top = zeros(Int64, 4)
+      popped = CxxWrap.StdLib.pq_pop_n!(top, q)
+      rest = CxxWrap.StdLib.pq_drain!(q)
+      popped == 4 && top == Int64[n-1, n-2, n-3, n-4] && length(rest) == n + 1 &&
+        rest == sort(vcat(keys[keys .< n-4], Int64[5, 1, 9, 7, 3]); rev=true) &&
+        CxxWrap.StdLib.pq_isempty(q) && CxxWrap.StdLib.pq_drain!(q) == Int64[]
+    end
+  )");
+  ok &= check("q_pop_n! and stack_pop_n! order", R"(
+    let n = 100_000, q = CxxWrap.StdLib.StdQueue{Int64}(), s = CxxWrap.StdLib.StdStack{Int64}(), dest = zeros(Int64, n + 10)
+      CxxWrap.StdLib.q_push_all!(q, collect(Int64, 1:n))
+      CxxWrap.StdLib.stack_push_all!(s, collect(Int64, 1:n))
+      first_two = zeros(Int64, 2)
+      queue_ok = CxxWrap.StdLib.q_pop_n!(first_two, q) == 2 && first_two == Int64[1, 2] &&
+        CxxWrap.StdLib.q_pop_n!(dest, q) == n - 2 && dest[1:n-2] == collect(Int64, 3:n) && CxxWrap.StdLib.q_empty(q)
+      stack_ok = CxxWrap.StdLib.stack_pop_n!(zeros(Int64, 0), s) == 0 &&
+        CxxWrap.StdLib.stack_drain!(s) == collect(Int64, n:-1:1) && CxxWrap.StdLib.stack_isempty(s)
+      queue_ok && stack_ok
+    end
+  )");
+  ok &= check("StdSort and StdStableSort over several chunks", R"(
+    let n = 200_000, keys = Float64.(mod.(collect(Int64, 0:n-1) .* 7919, 1000))
+      CxxWrap.StdLib.set_algorithm_threads(4)
+      # 0.0 and -0.0 compare equal, so their order after a stable sort shows whether equal elements were reordered
+      keys[1:7:end] .= ifelse.(isodd.(1:length(1:7:n)), 0.0, -0.0)
+      v = CxxWrap.StdLib.StdVector{Float64}()
+      w = CxxWrap.StdLib.StdVector{Float64}()
+      CxxWrap.StdLib.append(v, keys)
+      CxxWrap.StdLib.append(w, keys)
+      CxxWrap.StdLib.StdSort(v)
+      CxxWrap.StdLib.StdStableSort(w)
+      result = [v[i] for i in 1:n] == sort(keys) &&
+        isequal([w[i] for i in 1:n], sort(keys; alg=MergeSort, lt=(a, b) -> a < b))
+      CxxWrap.StdLib.set_algorithm_threads(0)
+      result
+    end
+  )");
+  ok &= check("StdReduce and StdTransformReduce widen small integers", R"(
+    let n = 100_000, a = CxxWrap.StdLib.StdVector{Int8}(), b = CxxWrap.StdLib.StdVector{Int16}(), c = CxxWrap.StdLib.StdVector{Int16}()
+      CxxWrap.StdLib.set_algorithm_threads(4)
+      CxxWrap.StdLib.append(a, fill(Int8(100), n))
+      CxxWrap.StdLib.append(b, fill(Int16(300), n))
+      CxxWrap.StdLib.append(c, fill(Int16(300), n + 1))
+      sum_a = CxxWrap.StdLib.StdReduce(a)
+      dot_b = CxxWrap.StdLib.StdTransformReduce(b, b)
+      result = sum_a === Int64(100) * n && dot_b === Int64(300 * 300) * n &&
+        throws_error(() -> CxxWrap.StdLib.StdTransformReduce(b, c)) &&
+        throws_error(() -> CxxWrap.StdLib.set_algorithm_threads(-1))
+      CxxWrap.StdLib.set_algorithm_threads(0)
+      result
+    end
+  )");
+  ok &= check("valarray integer division and shifts", R"(
+    let n = 100_000, StdLib = CxxWrap.StdLib
+      make_valarray(x) = (v = StdLib.StdValArray{Int64}(UInt(0)); StdLib.append(v, x); v)
+      contents(v) = (d = zeros(Int64, StdLib.cppsize(v)); StdLib.cxxcopyto!(d, v); d)
+      v = make_valarray(collect(Int64, 1:n))
+      StdLib.valarray_div!(v, 3)
+      div_ok = contents(v) == div.(1:n, 3)
+      rejected_ok = throws_error(() -> StdLib.valarray_div!(v, 0)) && throws_error(() -> StdLib.valarray_rem!(v, 0)) &&
+        throws_error(() -> StdLib.valarray_div!(v, make_valarray(vcat(ones(Int64, n - 1), 0)))) &&
+        throws_error(() -> StdLib.valarray_div!(make_valarray([typemin(Int64)]), -1)) &&
+        throws_error(() -> StdLib.valarray_rem!(make_valarray([typemin(Int64)]), -1)) &&
+        throws_error(() -> StdLib.valarray_div!(StdLib.StdValArray{Int64}(UInt(0)), 0)) &&
+        throws_error(() -> StdLib.valarray_shl!(v, 64)) && throws_error(() -> StdLib.valarray_shr!(v, -1)) &&
+        throws_error(() -> StdLib.valarray_shl!(v, make_valarray(vcat(zeros(Int64, n - 1), 64)))) &&
+        contents(v) == div.(1:n, 3)
+      w = make_valarray(collect(Int64, 1:n))
+      StdLib.valarray_shl!(w, 2)
+      StdLib.valarray_shr!(w, make_valarray(ones(Int64, n)))
+      div_ok && rejected_ok && contents(w) == 2 .* (1:n)
+    end
+  )");
+  ok &= check("valarray reductions and slices", R"(
+    let n = 100_000, StdLib = CxxWrap.StdLib
+      make_valarray(x) = (v = StdLib.StdValArray{Int64}(UInt(0)); StdLib.append(v, x); v)
+      contents(v) = (d = zeros(Int64, StdLib.cppsize(v)); StdLib.cxxcopyto!(d, v); d)
+      empty = StdLib.StdValArray{Int64}(UInt(0))
+      v = make_valarray(collect(Int64, 1:n))
+      odd = StdLib.StdSlice(UInt(0), UInt(n ÷ 2), UInt(2))
+      block = StdLib.StdGSlice(UInt(1), UInt[2, 3], UInt[10, 1])
+      reductions_ok = StdLib.valarray_sum(empty) == 0 && StdLib.valarray_sum(v) == n * (n + 1) ÷ 2 &&
+        throws_error(() -> StdLib.valarray_min(empty)) && throws_error(() -> StdLib.valarray_max(empty))
+      slices_ok = contents(StdLib.valarray_getslice(v, odd)) == collect(Int64, 1:2:n) &&
+        contents(StdLib.valarray_getslice(v, block)) == Int64[2, 3, 4, 12, 13, 14] &&
+        throws_error(() -> StdLib.valarray_getslice(v, StdLib.StdSlice(UInt(2), UInt(n ÷ 2), UInt(2)))) &&
+        throws_error(() -> StdLib.valarray_getslice(v, StdLib.StdGSlice(UInt(n - 5), UInt[2, 3], UInt[10, 1]))) &&
+        throws_error(() -> StdLib.valarray_getslice(v, StdLib.StdGSlice(UInt(0), UInt[2, 3], UInt[1]))) &&
+        throws_error(() -> StdLib.valarray_setslice!(v, make_valarray(zeros(Int64, 3)), odd)) &&
+        throws_error(() -> StdLib.valarray_addslice!(v, make_valarray(zeros(Int64, 5)), block))
+      StdLib.valarray_setslice!(v, 0, odd)
+      StdLib.valarray_addslice!(v, make_valarray(fill(Int64(100), 6)), block)
+      expected = [isodd(i) ? 0 : i for i in 1:n]
+      expected[[2, 3, 4, 12, 13, 14]] .+= 100
+      reductions_ok && slices_ok && contents(v) == expected
+    end
+  )");
+
+  jl_atexit_hook(0);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <jlcxx/jlcxx.hpp>
+#include <jlcxx/stl.hpp>
+
+// Lazy registration of the STL module: this test runs with JLCXX_LAZY_STL=1, so StdVector{Float64} is only
+// recorded as a deferred combination when CxxWrap loads. Instantiating it must wrap the type once and make its methods
+// available through get_module_functions_named, which is how the Julia side picks up the new methods.
+
+extern "C" JLCXX_API bool instantiate_stl_type(jl_datatype_t* applied_type);
+extern "C" JLCXX_API jl_array_t* get_module_functions_named(jl_module_t* jlmod, jl_value_t* name);
+extern "C" JLCXX_API jl_array_t* get_box_types(jl_module_t* jlmod);
+
+/// True if any of the CppFunctionInfo in functions has an argument type that mentions StdVector{Float64}
+bool has_float64_vector_method(jl_array_t* functions)
+{
+  jl_function_t* check = (jl_function_t*)jl_eval_string(R"(
+    functions -> any(f -> any(t -> occursin("StdVector{Float64}", string(t)), getfield(f, 2)), functions)
+  )");
+  jl_value_t* result = jl_call1(check, (jl_value_t*)functions);
+  return result != nullptr && jl_unbox_bool(result);
+}
+
+int main()
+{
+  jlcxx::cxxwrap_init();
+
+  jl_module_t* stl_mod = (jl_module_t*)jl_eval_string("CxxWrap.StdLib");
+  jl_datatype_t* applied = (jl_datatype_t*)jl_eval_string("CxxWrap.StdLib.StdVector{Float64}");
+  if(jl_exception_occurred() || stl_mod == nullptr || applied == nullptr)
+  {
+    std::cout << "StdLib module or StdVector type not found" << std::endl;
+    return 1;
+  }
+  jl_array_t* functions = nullptr;
+  JL_GC_PUSH3(&stl_mod, &applied, &functions);
+  bool ok = true;
+
+  if(!jlcxx::stl::lazy_stl())
+  {
+    std::cout << "StdLib types are not deferred, is JLCXX_LAZY_STL set?" << std::endl;
+    ok = false;
+  }
+  if(jlcxx::has_julia_type<std::vector<double>>())
+  {
+    std::cout << "std::vector<double> was wrapped before it was instantiated" << std::endl;
+    ok = false;
+  }
+  if(has_float64_vector_method(get_module_functions_named(stl_mod, (jl_value_t*)jl_symbol("push_back"))))
+  {
+    std::cout << "push_back for StdVector{Float64} exists before it was instantiated" << std::endl;
+    ok = false;
+  }
+
+  if(!instantiate_stl_type(applied))
+  {
+    std::cout << "StdVector{Float64} was not deferred" << std::endl;
+    ok = false;
+  }
+  if(!jlcxx::has_julia_type<std::vector<double>>())
+  {
+    std::cout << "std::vector<double> was not wrapped by instantiate_stl_type" << std::endl;
+    ok = false;
+  }
+  if(instantiate_stl_type(applied))
+  {
+    std::cout << "StdVector{Float64} was instantiated twice" << std::endl;
+    ok = false;
+  }
+
+  // Re-fetch the functions, as the Julia side must do after instantiating a type
+  functions = get_module_functions_named(stl_mod, (jl_value_t*)jl_symbol("push_back"));
+  get_box_types(stl_mod);
+  if(jl_exception_occurred() || !has_float64_vector_method(functions))
+  {
+    std::cout << "push_back for StdVector{Float64} is missing after instantiation" << std::endl;
+    ok = false;
+  }
+
+  JL_GC_POP();
+  jl_atexit_hook(0);
+  return ok ? 0 : 1;
+}